@@ -0,0 +1,260 @@
+/****************************************************************************
+**
+** Copyright 2024 Jiamu Sun
+** Contact: barroit@linux.com
+**
+** This file is part of livaut.
+**
+** livaut is free software: you can redistribute it and/or modify it
+** under the terms of the GNU General Public License as published by the
+** Free Software Foundation, either version 3 of the License, or (at your
+** option) any later version.
+**
+** livaut is distributed in the hope that it will be useful, but
+** WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+** General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License along
+** with livaut. If not, see <https://www.gnu.org/licenses/>.
+**
+****************************************************************************/
+
+/*
+ * drives encode_frame() against the fake rmt encoders, every frame of the
+ * schedule (and a few frames of the other protocols) is encoded with the
+ * channel memory running out at every possible symbol offset, the symbol
+ * stream must come out the same each time
+ *
+ * usage: encoder-bench [block-symbols [rounds]]
+ */
+
+#include "ir-protocol.h"
+#include "schedule.h"
+#include "fake-rmt.h"
+#include "list.h"
+#include "memory.h"
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+/* ping-pong half of the 256 symbol block (RMT_MEMORY_BLOCK_SIZE) */
+#define DEFAULT_BLOCK  128
+#define DEFAULT_ROUNDS 20000
+
+#define MAX_CALLS 100000
+
+struct encode_result {
+	size_t calls;   /* calls into encode_frame() */
+	size_t subcalls; /* calls into copy and bytes encoder */
+	size_t symbols;
+};
+
+static struct rmt_channel_t channel;
+
+/* 1 0 1 0 1 0 0 1 0 0 0 0 */
+static const u8 sony_bits[] = { 0x95, 0x00 };
+
+static struct tx_frame extra_frames[] = {
+	{
+		.proto = IR_NEC,
+		.delay = 255,
+		.bytes = { 0x04, 0xFB, 0x08, 0xF7 },
+		.cnum  = 2,
+		.unum  = 2,
+	},
+	{
+		.proto = IR_SONY,
+		.delay = 40,
+		.bnum  = 12,
+	},
+};
+
+/*
+ * the channel has ‘first’ free symbols on the first call, ‘block’ on the
+ * following ones
+ */
+static int encode(rmt_encoder_t *enc, struct tx_frame *frame,
+		  size_t first, size_t block, struct encode_result *res)
+{
+	rmt_encode_state_t state;
+	size_t len = 0;
+
+	channel.len = 0;
+	channel.free = first;
+	fake_encoder_calls = 0;
+	memset(res, 0, sizeof(*res));
+
+	while (39) {
+		len += enc->encode(enc, &channel, frame, sizeof(*frame),
+				   &state);
+		res->calls++;
+
+		if (state & RMT_ENCODING_COMPLETE)
+			break;
+
+		if (!(state & RMT_ENCODING_MEM_FULL))
+			return error("encode", "returned neither complete "
+				     "nor mem full");
+
+		if (res->calls > MAX_CALLS)
+			return error("encode", "no progress after %d calls",
+				     MAX_CALLS);
+
+		channel.free = block;
+	}
+
+	if (len != channel.len)
+		return error("encode", "reported %zu symbols, wrote %zu",
+			     len, channel.len);
+
+	res->subcalls = fake_encoder_calls;
+	res->symbols = channel.len;
+	return 0;
+}
+
+static int check_frame(rmt_encoder_t *enc, struct tx_frame *frame,
+		       const char *name)
+{
+	struct encode_result ref, res;
+	rmt_symbol_word_t *expect;
+	size_t i;
+	int err;
+
+	err = encode(enc, frame, SIZE_MAX, SIZE_MAX, &ref);
+	if (err)
+		return 1;
+
+	expect = xmalloc(ref.symbols * sizeof(*expect));
+	memcpy(expect, channel.mem, ref.symbols * sizeof(*expect));
+
+	for (i = 1; i <= ref.symbols; i++) {
+		/* run out once at offset i, then every i symbols */
+		err = encode(enc, frame, i, SIZE_MAX, &res) ||
+		      res.symbols != ref.symbols ||
+		      memcmp(expect, channel.mem, ref.symbols * 4) ||
+		      encode(enc, frame, i, i, &res) ||
+		      res.symbols != ref.symbols ||
+		      memcmp(expect, channel.mem, ref.symbols * 4);
+		if (err)
+			break;
+	}
+
+	free(expect);
+
+	if (err)
+		return error(name, "symbol stream differs when memory runs "
+			     "out at symbol %zu", i);
+
+	printf("%-16s %-5s %4zu symbols  %3zu sub-encoder calls\n",
+	       name, get_ir_protocol(frame->proto)->name,
+	       ref.symbols, ref.subcalls);
+	return 0;
+}
+
+static double elapsed_ns(const struct timespec *a, const struct timespec *b)
+{
+	return (b->tv_sec - a->tv_sec) * 1e9 + (b->tv_nsec - a->tv_nsec);
+}
+
+static void bench_frame(rmt_encoder_t *enc, struct tx_frame *frame,
+			const char *name, size_t block, size_t rounds)
+{
+	struct encode_result res = { 0 };
+	struct timespec start, end;
+	size_t i;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for_each_idx(i, rounds)
+		encode(enc, frame, block, block, &res);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	double ns = elapsed_ns(&start, &end) / rounds;
+
+	printf("%-16s %4zu calls  %9.1f ns/frame  %6.2f ns/symbol\n",
+	       name, res.calls, ns, ns / res.symbols);
+}
+
+struct test_frame {
+	struct tx_frame frame;
+	char name[16];
+};
+
+static size_t add_frames(struct test_frame *list, const char *kind,
+			 size_t idx, const struct signal_schedule *s)
+{
+	size_t j;
+
+	for_each_idx(j, s->fnum) {
+		load_frame(&list[j].frame, get_frame(s, j));
+		snprintf(list[j].name, sizeof(list[j].name),
+			 "%s %zu.%zu", kind, idx, j);
+	}
+
+	return s->fnum;
+}
+
+static size_t collect_frames(struct test_frame **list)
+{
+	size_t i, n = 0;
+	size_t cap = sizeof_array(extra_frames);
+
+	for_each_idx(i, get_schedule_num())
+		cap += get_schedule(i)->fnum;
+	for_each_idx(i, get_rule_num())
+		cap += get_rule(i)->fnum;
+
+	*list = xmalloc(cap * sizeof(**list));
+
+	for_each_idx(i, get_schedule_num())
+		n += add_frames(&(*list)[n], "schedule", i, get_schedule(i));
+	for_each_idx(i, get_rule_num())
+		n += add_frames(&(*list)[n], "rule", i, get_rule(i));
+
+	make_bit_symbols(extra_frames[1].bits, sony_bits,
+			 extra_frames[1].bnum, IR_SONY);
+
+	for_each_idx(i, sizeof_array(extra_frames)) {
+		(*list)[n].frame = extra_frames[i];
+		snprintf((*list)[n].name, sizeof((*list)[n].name),
+			 "extra %zu", i);
+		n++;
+	}
+
+	return n;
+}
+
+int main(int argc, char **argv)
+{
+	size_t block = argc > 1 ? strtoul(argv[1], NULL, 10) : DEFAULT_BLOCK;
+	size_t rounds = argc > 2 ? strtoul(argv[2], NULL, 10) :
+				   DEFAULT_ROUNDS;
+	rmt_encoder_handle_t enc;
+	struct test_frame *frames;
+	size_t i, n;
+	int err = 0;
+
+	if (!block || !rounds)
+		die("encoder-bench", "block and rounds must be positive");
+
+	if (make_ir_encoder(&enc))
+		die("encoder-bench", "failed to make encoder");
+
+	n = collect_frames(&frames);
+
+	puts("resumability");
+	for_each_idx(i, n)
+		err |= check_frame(enc, &frames[i].frame, frames[i].name);
+
+	printf("\nthroughput (%zu symbol blocks, %zu rounds)\n",
+	       block, rounds);
+	for_each_idx(i, n)
+		bench_frame(enc, &frames[i].frame, frames[i].name,
+			    block, rounds);
+
+	enc->del(enc);
+	free(frames);
+	free(channel.mem);
+
+	return err;
+}
@@ -0,0 +1,33 @@
+/****************************************************************************
+**
+** Copyright 2024 Jiamu Sun
+** Contact: barroit@linux.com
+**
+** This file is part of livaut.
+**
+** livaut is free software: you can redistribute it and/or modify it
+** under the terms of the GNU General Public License as published by the
+** Free Software Foundation, either version 3 of the License, or (at your
+** option) any later version.
+**
+** livaut is distributed in the hope that it will be useful, but
+** WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+** General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License along
+** with livaut. If not, see <https://www.gnu.org/licenses/>.
+**
+****************************************************************************/
+
+#ifndef FAKE_RMT_RX_H
+#define FAKE_RMT_RX_H
+
+#include "driver/rmt_tx.h"
+
+typedef struct {
+	uint32_t signal_range_min_ns;
+	uint32_t signal_range_max_ns;
+} rmt_receive_config_t;
+
+#endif /* FAKE_RMT_RX_H */
@@ -0,0 +1,102 @@
+/****************************************************************************
+**
+** Copyright 2024 Jiamu Sun
+** Contact: barroit@linux.com
+**
+** This file is part of livaut.
+**
+** livaut is free software: you can redistribute it and/or modify it
+** under the terms of the GNU General Public License as published by the
+** Free Software Foundation, either version 3 of the License, or (at your
+** option) any later version.
+**
+** livaut is distributed in the hope that it will be useful, but
+** WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+** General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License along
+** with livaut. If not, see <https://www.gnu.org/licenses/>.
+**
+****************************************************************************/
+
+/*
+ * host stand-in for the esp-idf rmt encoder interface, only what the
+ * encoders in src/ use
+ */
+
+#ifndef FAKE_RMT_TX_H
+#define FAKE_RMT_TX_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include "esp_err.h"
+
+typedef union {
+	struct {
+		uint16_t duration0 : 15;
+		uint16_t level0 : 1;
+		uint16_t duration1 : 15;
+		uint16_t level1 : 1;
+	};
+	unsigned int val;
+} rmt_symbol_word_t;
+
+typedef enum {
+	RMT_ENCODING_RESET    = 0,
+	RMT_ENCODING_COMPLETE = (1 << 0),
+	RMT_ENCODING_MEM_FULL = (1 << 1),
+} rmt_encode_state_t;
+
+typedef struct rmt_channel_t *rmt_channel_handle_t;
+typedef struct rmt_encoder_t rmt_encoder_t;
+typedef struct rmt_encoder_t *rmt_encoder_handle_t;
+
+struct rmt_encoder_t {
+	size_t (*encode)(rmt_encoder_t *encoder, rmt_channel_handle_t channel,
+			 const void *primary_data, size_t data_size,
+			 rmt_encode_state_t *ret_state);
+	esp_err_t (*reset)(rmt_encoder_t *encoder);
+	esp_err_t (*del)(rmt_encoder_t *encoder);
+};
+
+typedef struct {
+	rmt_symbol_word_t bit0;
+	rmt_symbol_word_t bit1;
+	struct {
+		uint32_t msb_first : 1;
+	} flags;
+} rmt_bytes_encoder_config_t;
+
+typedef struct {
+} rmt_copy_encoder_config_t;
+
+esp_err_t rmt_new_bytes_encoder(const rmt_bytes_encoder_config_t *config,
+				rmt_encoder_handle_t *ret_encoder);
+
+esp_err_t rmt_new_copy_encoder(const rmt_copy_encoder_config_t *config,
+			       rmt_encoder_handle_t *ret_encoder);
+
+esp_err_t rmt_del_encoder(rmt_encoder_handle_t encoder);
+
+esp_err_t rmt_encoder_reset(rmt_encoder_handle_t encoder);
+
+void *rmt_alloc_encoder_mem(size_t size);
+
+#define __containerof(ptr, type, member) \
+	((type *)((char *)(ptr) - offsetof(type, member)))
+
+/*
+ * the fake channel memory, encoders write into it until ‘free’ symbols are
+ * used up, then they report RMT_ENCODING_MEM_FULL
+ */
+struct rmt_channel_t {
+	rmt_symbol_word_t *mem;
+	size_t len;
+	size_t cap;
+	size_t free;
+};
+
+#endif /* FAKE_RMT_TX_H */
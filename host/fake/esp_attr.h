@@ -0,0 +1,29 @@
+/****************************************************************************
+**
+** Copyright 2024 Jiamu Sun
+** Contact: barroit@linux.com
+**
+** This file is part of livaut.
+**
+** livaut is free software: you can redistribute it and/or modify it
+** under the terms of the GNU General Public License as published by the
+** Free Software Foundation, either version 3 of the License, or (at your
+** option) any later version.
+**
+** livaut is distributed in the hope that it will be useful, but
+** WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+** General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License along
+** with livaut. If not, see <https://www.gnu.org/licenses/>.
+**
+****************************************************************************/
+
+#ifndef FAKE_ESP_ATTR_H
+#define FAKE_ESP_ATTR_H
+
+#define IRAM_ATTR
+#define RTC_DATA_ATTR
+
+#endif /* FAKE_ESP_ATTR_H */
@@ -0,0 +1,77 @@
+/****************************************************************************
+**
+** Copyright 2024 Jiamu Sun
+** Contact: barroit@linux.com
+**
+** This file is part of livaut.
+**
+** livaut is free software: you can redistribute it and/or modify it
+** under the terms of the GNU General Public License as published by the
+** Free Software Foundation, either version 3 of the License, or (at your
+** option) any later version.
+**
+** livaut is distributed in the hope that it will be useful, but
+** WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+** General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License along
+** with livaut. If not, see <https://www.gnu.org/licenses/>.
+**
+****************************************************************************/
+
+#ifndef FAKE_ESP_PARTITION_H
+#define FAKE_ESP_PARTITION_H
+
+#include "esp_err.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/* there is no partition on the host, the built-in schedule is used */
+
+typedef enum {
+	ESP_PARTITION_TYPE_DATA = 0x01,
+} esp_partition_type_t;
+
+typedef enum {
+	ESP_PARTITION_MMAP_DATA,
+} esp_partition_mmap_memory_t;
+
+typedef uint32_t esp_partition_mmap_handle_t;
+
+typedef struct {
+	uint32_t size;
+	char label[17];
+} esp_partition_t;
+
+static inline const esp_partition_t *
+esp_partition_find_first(esp_partition_type_t, int, const char *)
+{
+	return NULL;
+}
+
+static inline esp_err_t
+esp_partition_mmap(const esp_partition_t *, size_t, size_t,
+		   esp_partition_mmap_memory_t, const void **,
+		   esp_partition_mmap_handle_t *)
+{
+	return ESP_ERR_NOT_SUPPORTED;
+}
+
+static inline void esp_partition_munmap(esp_partition_mmap_handle_t)
+{
+}
+
+static inline esp_err_t
+esp_partition_erase_range(const esp_partition_t *, size_t, size_t)
+{
+	return ESP_ERR_NOT_SUPPORTED;
+}
+
+static inline esp_err_t
+esp_partition_write(const esp_partition_t *, size_t, const void *, size_t)
+{
+	return ESP_ERR_NOT_SUPPORTED;
+}
+
+#endif /* FAKE_ESP_PARTITION_H */
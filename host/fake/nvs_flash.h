@@ -0,0 +1,55 @@
+/****************************************************************************
+**
+** Copyright 2024 Jiamu Sun
+** Contact: barroit@linux.com
+**
+** This file is part of livaut.
+**
+** livaut is free software: you can redistribute it and/or modify it
+** under the terms of the GNU General Public License as published by the
+** Free Software Foundation, either version 3 of the License, or (at your
+** option) any later version.
+**
+** livaut is distributed in the hope that it will be useful, but
+** WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+** General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License along
+** with livaut. If not, see <https://www.gnu.org/licenses/>.
+**
+****************************************************************************/
+
+/*
+ * host stand-in for the esp-idf nvs interface, only what src/ uses, see
+ * scheduler-sim.c for the implementation
+ */
+
+#ifndef FAKE_NVS_FLASH_H
+#define FAKE_NVS_FLASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+typedef uint32_t nvs_handle_t;
+
+typedef enum {
+	NVS_READONLY,
+	NVS_READWRITE,
+} nvs_open_mode_t;
+
+esp_err_t nvs_open(const char *name, nvs_open_mode_t mode,
+		   nvs_handle_t *handle);
+
+void nvs_close(nvs_handle_t handle);
+
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char *key, void *value,
+		       size_t *length);
+
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char *key,
+		       const void *value, size_t length);
+
+esp_err_t nvs_commit(nvs_handle_t handle);
+
+#endif /* FAKE_NVS_FLASH_H */
@@ -0,0 +1,201 @@
+/****************************************************************************
+**
+** Copyright 2024 Jiamu Sun
+** Contact: barroit@linux.com
+**
+** This file is part of livaut.
+**
+** livaut is free software: you can redistribute it and/or modify it
+** under the terms of the GNU General Public License as published by the
+** Free Software Foundation, either version 3 of the License, or (at your
+** option) any later version.
+**
+** livaut is distributed in the hope that it will be useful, but
+** WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+** General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License along
+** with livaut. If not, see <https://www.gnu.org/licenses/>.
+**
+****************************************************************************/
+
+/*
+ * host versions of the rmt copy and bytes encoders, they follow the contract
+ * of the esp-idf ones: resume where they stopped, report MEM_FULL once the
+ * channel memory is used up and reset themselves on completion
+ *
+ * unlike esp-idf, MEM_FULL is also reported when the input ends exactly at
+ * the memory boundary, so callers see COMPLETE | MEM_FULL as often as
+ * possible
+ */
+
+#include "driver/rmt_tx.h"
+#include "fake-rmt.h"
+#include <string.h>
+
+size_t fake_encoder_calls;
+
+struct copy_encoder {
+	rmt_encoder_t base;
+	size_t next;
+};
+
+struct bytes_encoder {
+	rmt_encoder_t base;
+	rmt_symbol_word_t bit0;
+	rmt_symbol_word_t bit1;
+	int msb_first;
+	size_t next; /* in bits */
+};
+
+static void emit_symbol(rmt_channel_handle_t ch, rmt_symbol_word_t sym)
+{
+	if (ch->len == ch->cap) {
+		ch->cap = ch->cap ? ch->cap * 2 : 256;
+		ch->mem = realloc(ch->mem, ch->cap * sizeof(*ch->mem));
+		if (!ch->mem)
+			abort();
+	}
+
+	ch->mem[ch->len++] = sym;
+	ch->free--;
+}
+
+static rmt_encode_state_t make_state(int done, rmt_channel_handle_t ch)
+{
+	rmt_encode_state_t state = RMT_ENCODING_RESET;
+
+	if (done)
+		state |= RMT_ENCODING_COMPLETE;
+	if (!ch->free)
+		state |= RMT_ENCODING_MEM_FULL;
+
+	return state;
+}
+
+static size_t encode_copy(rmt_encoder_t *enc, rmt_channel_handle_t ch,
+			  const void *dat, size_t size,
+			  rmt_encode_state_t *state)
+{
+	struct copy_encoder *c = __containerof(enc, struct copy_encoder, base);
+	const rmt_symbol_word_t *sym = dat;
+	size_t num = size / sizeof(*sym);
+	size_t len = 0;
+
+	fake_encoder_calls++;
+
+	while (c->next < num && ch->free) {
+		emit_symbol(ch, sym[c->next++]);
+		len++;
+	}
+
+	int done = c->next == num;
+	if (done)
+		c->next = 0;
+
+	*state = make_state(done, ch);
+	return len;
+}
+
+static size_t encode_bytes(rmt_encoder_t *enc, rmt_channel_handle_t ch,
+			   const void *dat, size_t size,
+			   rmt_encode_state_t *state)
+{
+	struct bytes_encoder *b = __containerof(enc, struct bytes_encoder, base);
+	const uint8_t *buf = dat;
+	size_t num = size * 8;
+	size_t len = 0;
+
+	fake_encoder_calls++;
+
+	while (b->next < num && ch->free) {
+		uint8_t byte = buf[b->next / 8];
+		unsigned pos = b->next % 8;
+		int bit = b->msb_first ? (byte >> (7 - pos)) & 1 :
+					 (byte >> pos) & 1;
+
+		emit_symbol(ch, bit ? b->bit1 : b->bit0);
+		b->next++;
+		len++;
+	}
+
+	int done = b->next == num;
+	if (done)
+		b->next = 0;
+
+	*state = make_state(done, ch);
+	return len;
+}
+
+static esp_err_t reset_copy(rmt_encoder_t *enc)
+{
+	__containerof(enc, struct copy_encoder, base)->next = 0;
+	return ESP_OK;
+}
+
+static esp_err_t reset_bytes(rmt_encoder_t *enc)
+{
+	__containerof(enc, struct bytes_encoder, base)->next = 0;
+	return ESP_OK;
+}
+
+static esp_err_t free_copy(rmt_encoder_t *enc)
+{
+	free(__containerof(enc, struct copy_encoder, base));
+	return ESP_OK;
+}
+
+static esp_err_t free_bytes(rmt_encoder_t *enc)
+{
+	free(__containerof(enc, struct bytes_encoder, base));
+	return ESP_OK;
+}
+
+esp_err_t rmt_new_copy_encoder(const rmt_copy_encoder_config_t *,
+			       rmt_encoder_handle_t *ret)
+{
+	struct copy_encoder *c = calloc(1, sizeof(*c));
+	if (!c)
+		return ESP_ERR_NO_MEM;
+
+	c->base.encode = encode_copy;
+	c->base.reset  = reset_copy;
+	c->base.del    = free_copy;
+
+	*ret = &c->base;
+	return ESP_OK;
+}
+
+esp_err_t rmt_new_bytes_encoder(const rmt_bytes_encoder_config_t *conf,
+				rmt_encoder_handle_t *ret)
+{
+	struct bytes_encoder *b = calloc(1, sizeof(*b));
+	if (!b)
+		return ESP_ERR_NO_MEM;
+
+	b->base.encode = encode_bytes;
+	b->base.reset  = reset_bytes;
+	b->base.del    = free_bytes;
+	b->bit0        = conf->bit0;
+	b->bit1        = conf->bit1;
+	b->msb_first   = conf->flags.msb_first;
+
+	*ret = &b->base;
+	return ESP_OK;
+}
+
+esp_err_t rmt_del_encoder(rmt_encoder_handle_t enc)
+{
+	return enc->del(enc);
+}
+
+esp_err_t rmt_encoder_reset(rmt_encoder_handle_t enc)
+{
+	return enc->reset(enc);
+}
+
+void *rmt_alloc_encoder_mem(size_t size)
+{
+	return calloc(1, size);
+}
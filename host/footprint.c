@@ -0,0 +1,223 @@
+/****************************************************************************
+**
+** Copyright 2024 Jiamu Sun
+** Contact: barroit@linux.com
+**
+** This file is part of livaut.
+**
+** livaut is free software: you can redistribute it and/or modify it
+** under the terms of the GNU General Public License as published by the
+** Free Software Foundation, either version 3 of the License, or (at your
+** option) any later version.
+**
+** livaut is distributed in the hope that it will be useful, but
+** WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+** General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License along
+** with livaut. If not, see <https://www.gnu.org/licenses/>.
+**
+****************************************************************************/
+
+/*
+ * reports the bytes taken by the generated schedule and by the buffers the
+ * firmware sizes after it, and fails when a budget is exceeded
+ *
+ * the built-in blob is const, so it stays in flash (.rodata), tx slots and
+ * the rx symbol buffer are zeroed ram (.bss), the scheduler state lives in
+ * rtc slow memory
+ *
+ * usage: footprint [flash-budget ram-budget rtc-budget]
+ */
+
+#include "ir-protocol.h"
+#include "schedule.h"
+#include "transmit.h"
+#include "punctuality.h"
+#include "sntp.h"
+#include "power.h"
+#include "rmt.h"
+#include "termio.h"
+#include "list.h"
+#include "memory.h"
+#include "signal-schedule.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TAG "footprint"
+
+/*
+ * nothing measured here is initialized and writable, .data is left to the
+ * linker map of the firmware
+ */
+enum section {
+	SEC_RODATA,
+	SEC_BSS,
+	SEC_RTC,
+	SEC_NUM,
+};
+
+static const char *section_name[SEC_NUM] = {
+	[SEC_RODATA] = ".rodata",
+	[SEC_BSS]    = ".bss",
+	[SEC_RTC]    = ".rtc.data",
+};
+
+static size_t section_size[SEC_NUM];
+
+static void report(const char *name, size_t num, size_t each,
+		   enum section sec)
+{
+	size_t bytes = num * each;
+
+	section_size[sec] += bytes;
+	printf("%-18s %6zu x %4zu  %7zu  %s\n",
+	       name, num, each, bytes, section_name[sec]);
+}
+
+struct payload_ref {
+	u16 off;
+	u8 len;
+};
+
+static int cmp_ref(const void *a, const void *b)
+{
+	const struct payload_ref *x = a, *y = b;
+
+	if (x->off != y->off)
+		return x->off - y->off;
+	return x->len - y->len;
+}
+
+static void add_ref(struct payload_ref *refs, size_t *n, u16 off, u8 len)
+{
+	if (!len)
+		return;
+
+	refs[*n].off = off;
+	refs[*n].len = len;
+	(*n)++;
+}
+
+/*
+ * make-schedule stores identical byte sequences once, every frame field
+ * pointing at a sequence another field points at is a duplicate it folded
+ */
+static void report_duplicates(const struct frame_info *frames, size_t num)
+{
+	struct payload_ref *refs = xmalloc((num * 3 + 1) * sizeof(*refs));
+	size_t i, n = 0, dup = 0, saved = 0;
+
+	for_each_idx(i, num) {
+		const struct frame_info *f = &frames[i];
+
+		add_ref(refs, &n, f->code, f->cnum);
+		add_ref(refs, &n, f->data, f->unum);
+		add_ref(refs, &n, f->bits, (f->bnum + 7) / 8);
+	}
+
+	qsort(refs, n, sizeof(*refs), cmp_ref);
+
+	for (i = 1; i < n; i++) {
+		if (cmp_ref(&refs[i - 1], &refs[i]))
+			continue;
+		dup++;
+		saved += refs[i].len;
+	}
+
+	printf("%zu payload references, %zu duplicates folded, "
+	       "%zu bytes saved\n", n, dup, saved);
+	free(refs);
+}
+
+static int check_budget(const char *name, size_t used, size_t budget)
+{
+	printf("%-6s %7zu / %7zu bytes\n", name, used, budget);
+
+	if (used > budget)
+		return error(TAG, "%s footprint %zu exceeds the budget of %zu "
+			     "bytes", name, used, budget);
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	struct schedule_header head;
+	const u8 *p = schedule_blob;
+	size_t i, total = 0;
+	int err = 0;
+
+	if (argc != 1 && argc != 4)
+		die(TAG, "usage: footprint [flash-budget ram-budget "
+		    "rtc-budget]");
+
+	memcpy(&head, p, sizeof(head));
+
+	puts("table                count   each    bytes  section");
+	report("schedule header", 1, sizeof(head), SEC_RODATA);
+	report("schedule entries", head.entries,
+	       sizeof(struct signal_schedule), SEC_RODATA);
+	p += sizeof(head) + head.entries * sizeof(struct signal_schedule);
+
+	report("frame infos", head.frames, sizeof(struct frame_info),
+	       SEC_RODATA);
+	const struct frame_info *frames = (const struct frame_info *)p;
+
+	report("time-wheel", 1, sizeof(struct schedule_wheel), SEC_RODATA);
+	report("wheel events", head.events, sizeof(u16), SEC_RODATA);
+	report("rules", head.rules, sizeof(struct schedule_rule),
+	       SEC_RODATA);
+	report("payload", head.payload, 1, SEC_RODATA);
+
+	if (section_size[SEC_RODATA] != sizeof(schedule_blob))
+		err |= error(TAG, "tables add up to %zu bytes, the blob has "
+			     "%zu", section_size[SEC_RODATA],
+			     sizeof(schedule_blob));
+
+	report("tx slots", TRANSFER_SLOTS, sizeof(struct tx_frame), SEC_BSS);
+	report("tx start times", TRANSFER_SLOTS, sizeof(u64), SEC_BSS);
+	report("rx symbols", RMT_MEMORY_BLOCK_SIZE,
+	       sizeof(rmt_symbol_word_t), SEC_BSS);
+	report("scheduler state", 1, sizeof(struct scheduler_state),
+	       SEC_RTC);
+	report("punctuality", 1, sizeof(struct punctuality), SEC_RTC);
+	report("sntp sync state", 1, sizeof(struct sync_state), SEC_RTC);
+	report("sleep plan", 1, sizeof(struct sleep_plan), SEC_RTC);
+
+	/* channel memory of the rmt peripheral, not taken from dram */
+	printf("%-18s %6d x %4zu  %7zu  rmt memory\n", "tx/rx channel",
+	       RMT_MEMORY_BLOCK_SIZE, sizeof(rmt_symbol_word_t),
+	       RMT_MEMORY_BLOCK_SIZE * sizeof(rmt_symbol_word_t));
+
+	putchar('\n');
+	report_duplicates(frames, head.frames);
+
+	if (head.entries + head.rules)
+		printf("%zu bytes of schedule for %u entries and %u rules, "
+		       "%zu bytes each\n", sizeof(schedule_blob),
+		       head.entries, head.rules,
+		       sizeof(schedule_blob) / (head.entries + head.rules));
+
+	for_each_idx(i, SEC_NUM)
+		total += section_size[i];
+
+	putchar('\n');
+	for_each_idx(i, SEC_NUM)
+		printf("%-10s %7zu bytes  %5.1f%%\n", section_name[i],
+		       section_size[i],
+		       total ? section_size[i] * 100.0 / total : 0.0);
+
+	if (argc == 4) {
+		putchar('\n');
+		err |= check_budget("flash", section_size[SEC_RODATA],
+				    strtoul(argv[1], NULL, 0));
+		err |= check_budget("ram", section_size[SEC_BSS],
+				    strtoul(argv[2], NULL, 0));
+		err |= check_budget("rtc", section_size[SEC_RTC],
+				    strtoul(argv[3], NULL, 0));
+	}
+
+	return err;
+}
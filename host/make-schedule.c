@@ -0,0 +1,1169 @@
+/****************************************************************************
+**
+** Copyright 2024 Jiamu Sun
+** Contact: barroit@linux.com
+**
+** This file is part of livaut.
+**
+** livaut is free software: you can redistribute it and/or modify it
+** under the terms of the GNU General Public License as published by the
+** Free Software Foundation, either version 3 of the License, or (at your
+** option) any later version.
+**
+** livaut is distributed in the hope that it will be useful, but
+** WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+** General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License along
+** with livaut. If not, see <https://www.gnu.org/licenses/>.
+**
+****************************************************************************/
+
+/*
+ * compiles schedule tracks into signal-schedule-def.h, signal-schedule.h
+ * and the raw schedule image, for uploading to the schedule partition
+ *
+ * usage: make-schedule <def-header> <list-header> <image> <input>...
+ *
+ * an input is a schedule.in of its own, usually one per appliance, and each
+ * ‘on’ in it starts a track, tracks are merged into one timeline, entries
+ * of the same second are sent together, then the timeline is laid out as a
+ * weekly time-wheel
+ *
+ * see schedule.in for the syntax, everything is checked in one pass and the
+ * first error stops the build
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdarg.h>
+#include <ctype.h>
+#include <errno.h>
+
+#define MAX_TOKENS   256
+#define MAX_BYTES    255   /* frame_info.cnum, unum and bnum are uint8_t */
+#define MAX_FRAMES   255   /* signal_schedule.fnum is uint8_t */
+#define MAX_PARAMS   9
+#define MAX_DELAY    255   /* ms, frame_info.delay is uint8_t */
+#define MAX_OFFSET   65535 /* offsets and indexes are uint16_t */
+
+#define SCHEDULE_MAGIC   0x4353564C /* "LVSC" */
+#define SCHEDULE_VERSION 5
+#define CRC_OFFSET       12 /* the crc covers the image from ‘size’ on */
+
+#define MAX_RULES     16 /* schedule_header.rules is uint8_t */
+#define MAX_PERIOD    1440 /* minutes */
+
+#define WHEEL_DAYS    7
+#define WHEEL_BUCKETS 24 /* per day, of an hour each */
+
+struct buf {
+	char *s;
+	size_t len;
+	size_t cap;
+};
+
+struct template {
+	char *name;
+	char **code;
+	size_t cnum;
+	char **data;
+	size_t dnum;
+};
+
+struct pool_entry {
+	const void *key;
+	size_t n;
+	size_t id;
+	struct pool_entry *next;
+};
+
+#define POOL_BUCKETS 4096
+
+struct pool {
+	struct pool_entry *bucket[POOL_BUCKETS];
+};
+
+struct frame {
+	unsigned delay;
+	unsigned proto;
+	int isbit;
+	uint8_t bytes[MAX_BYTES];
+	size_t cnum;
+	size_t num;
+	uint8_t bits[MAX_BYTES];
+	size_t bnum;
+};
+
+/*
+ * host side of struct frame_info and struct signal_schedule, written out
+ * field by field in little endian
+ */
+struct frame_rec {
+	uint16_t code;
+	uint16_t data;
+	uint16_t bits;
+	uint8_t cnum;
+	uint8_t unum;
+	uint8_t bnum;
+	uint8_t delay;
+	uint8_t proto;
+	uint8_t days;
+};
+
+struct entry_rec {
+	uint32_t start;
+	uint16_t frame;
+	uint8_t fnum;
+	uint8_t days;
+};
+
+struct track_entry {
+	uint32_t start;
+	struct frame_rec *frames;
+	size_t fnum;
+};
+
+struct track {
+	uint8_t ondays;
+	struct track_entry *entries;
+	size_t num;
+	size_t rule_num;
+};
+
+/* host side of struct schedule_rule */
+struct rule_rec {
+	struct entry_rec base;
+	uint32_t end;
+	uint32_t period;
+};
+
+/* in the order of enum ir_protocol_id */
+static const char *protocols[] = {
+	"aeha",
+	"nec",
+	"sony",
+};
+
+static const char *input;
+static size_t lineno;
+
+static struct template *templates;
+static size_t template_num;
+
+static struct buf payload;
+static struct pool payload_pool;
+
+static struct frame_rec *frames;
+static size_t frame_num;
+static struct pool frame_pool;
+
+static struct entry_rec *entries;
+static size_t entry_num;
+
+static struct track *tracks;
+static size_t track_num;
+static uint8_t all_days;
+
+static struct rule_rec rules[MAX_RULES];
+static size_t rule_num;
+static uint8_t rule_days;
+
+/*
+ * the weekly time-wheel, host side of struct schedule_wheel, events holds
+ * the entries of each day in time order
+ */
+static uint16_t wheel_day[WHEEL_DAYS + 1];
+static uint16_t wheel_bucket[WHEEL_DAYS][WHEEL_BUCKETS];
+static uint8_t wheel_next_day[WHEEL_DAYS];
+static uint16_t *events;
+static size_t event_num;
+
+/* frames of the entry being parsed, or being merged */
+static struct frame_rec pending[MAX_FRAMES];
+static size_t pending_num;
+
+static size_t max_bytes = 1;
+static size_t max_bits = 1;
+
+static void die(const char *fmt, ...)
+{
+	va_list ap;
+
+	va_start(ap, fmt);
+	if (lineno)
+		fprintf(stderr, "%s:%zu: ", input, lineno);
+	vfprintf(stderr, fmt, ap);
+	fputc('\n', stderr);
+	va_end(ap);
+
+	exit(1);
+}
+
+static void *xrealloc(void *p, size_t n)
+{
+	p = realloc(p, n);
+	if (!p)
+		die("out of memory");
+	return p;
+}
+
+static char *xstrdup(const char *s)
+{
+	char *p = strdup(s);
+	if (!p)
+		die("out of memory");
+	return p;
+}
+
+static void buf_putn(struct buf *b, const char *s, size_t n)
+{
+	if (b->len + n + 1 > b->cap) {
+		b->cap = (b->len + n + 1) * 2;
+		b->s = xrealloc(b->s, b->cap);
+	}
+
+	memcpy(b->s + b->len, s, n);
+	b->len += n;
+	b->s[b->len] = 0;
+}
+
+static size_t split(char *line, char **tok)
+{
+	size_t n = 0;
+	char *p = strtok(line, " \t\r\n");
+
+	while (p) {
+		if (n == MAX_TOKENS)
+			die("too many tokens (max %d)", MAX_TOKENS);
+		tok[n++] = p;
+		p = strtok(NULL, " \t\r\n");
+	}
+
+	return n;
+}
+
+static unsigned long parse_uint(const char *s, unsigned long max,
+				const char *what)
+{
+	char *end;
+	unsigned long v;
+
+	if (!isdigit((unsigned char)*s))
+		die("invalid %s ‘%s’", what, s);
+
+	errno = 0;
+	v = strtoul(s, &end, 10);
+	if (errno || *end || v > max)
+		die("invalid %s ‘%s’ (max %lu)", what, s, max);
+
+	return v;
+}
+
+static unsigned long parse_time(const char *s)
+{
+	unsigned h, m, sec;
+	char tail;
+
+	if (sscanf(s, "%2u:%2u:%2u%c", &h, &m, &sec, &tail) != 3 ||
+	    strlen(s) != 8 || h > 23 || m > 59 || sec > 59)
+		die("invalid time ‘%s’ (expected HH:MM:SS)", s);
+
+	return h * 3600 + m * 60 + sec;
+}
+
+static uint8_t parse_byte(const char *s)
+{
+	if (!isxdigit((unsigned char)s[0]) ||
+	    !isxdigit((unsigned char)s[1]) || s[2])
+		die("invalid byte ‘%s’ (expected two hex digits)", s);
+
+	return strtoul(s, NULL, 16);
+}
+
+static int find_protocol(const char *name)
+{
+	size_t i;
+
+	for (i = 0; i < sizeof(protocols) / sizeof(*protocols); i++)
+		if (!strcmp(protocols[i], name))
+			return i;
+
+	return -1;
+}
+
+static struct template *find_template(const char *name)
+{
+	size_t i;
+
+	for (i = 0; i < template_num; i++)
+		if (!strcmp(templates[i].name, name))
+			return &templates[i];
+
+	return NULL;
+}
+
+static void push_tokens(char ***arr, size_t *n, char **tok, size_t m)
+{
+	size_t i;
+
+	*arr = xrealloc(*arr, (*n + m) * sizeof(**arr));
+	for (i = 0; i < m; i++)
+		(*arr)[(*n)++] = xstrdup(tok[i]);
+}
+
+static uint64_t hash_bytes(const uint8_t *b, size_t n)
+{
+	uint64_t h = 14695981039346656037ULL;
+	size_t i;
+
+	for (i = 0; i < n; i++)
+		h = (h ^ b[i]) * 1099511628211ULL;
+
+	return h;
+}
+
+static struct pool_entry *pool_find(struct pool *p, const void *key,
+				    size_t n, struct pool_entry ***head)
+{
+	struct pool_entry *e;
+
+	*head = &p->bucket[hash_bytes(key, n) % POOL_BUCKETS];
+	for (e = **head; e; e = e->next)
+		if (e->n == n && !memcmp(e->key, key, n))
+			return e;
+
+	return NULL;
+}
+
+static void pool_add(struct pool_entry **head, const void *key, size_t n,
+		     size_t id)
+{
+	struct pool_entry *e = xrealloc(NULL, sizeof(*e));
+	void *copy = xrealloc(NULL, n ? n : 1);
+
+	memcpy(copy, key, n);
+	e->key = copy;
+	e->n = n;
+	e->id = id;
+	e->next = *head;
+	*head = e;
+}
+
+/* identical byte sequences are stored once, returns the payload offset */
+static uint16_t intern_payload(const uint8_t *b, size_t n)
+{
+	struct pool_entry **head;
+	struct pool_entry *e = pool_find(&payload_pool, b, n, &head);
+	size_t off;
+
+	if (e)
+		return e->id;
+
+	off = payload.len;
+	if (off + n > MAX_OFFSET)
+		die("payload exceeds %d bytes", MAX_OFFSET);
+
+	buf_putn(&payload, (const char *)b, n);
+	pool_add(head, b, n, off);
+
+	return off;
+}
+
+/* identical frame lists are stored once, returns the frame index */
+static uint16_t intern_frames(const struct frame_rec *f, size_t n)
+{
+	struct pool_entry **head;
+	struct pool_entry *e = pool_find(&frame_pool, f, n * sizeof(*f),
+					 &head);
+	size_t idx;
+
+	if (e)
+		return e->id;
+
+	idx = frame_num;
+	if (idx + n > MAX_OFFSET)
+		die("schedule exceeds %d frames", MAX_OFFSET);
+
+	frames = xrealloc(frames, (frame_num + n) * sizeof(*frames));
+	memcpy(&frames[frame_num], f, n * sizeof(*f));
+	frame_num += n;
+	pool_add(head, f, n * sizeof(*f), idx);
+
+	return idx;
+}
+
+/* ‘SUM’ is the sum of all preceding bytes of the frame */
+static void push_byte(struct frame *f, const char *tok)
+{
+	uint8_t v = 0;
+	size_t i;
+
+	if (f->num == MAX_BYTES)
+		die("frame too long (max %d bytes)", MAX_BYTES);
+
+	if (!strcmp(tok, "SUM")) {
+		for (i = 0; i < f->num; i++)
+			v += f->bytes[i];
+	} else {
+		v = parse_byte(tok);
+	}
+
+	f->bytes[f->num++] = v;
+}
+
+static const char *substitute(const char *tok, char **args, size_t argc,
+			      const char *name)
+{
+	unsigned long n;
+
+	if (tok[0] != '$')
+		return tok;
+
+	n = parse_uint(tok + 1, MAX_PARAMS, "template parameter");
+	if (n == 0 || n > argc)
+		die("missing parameter $%lu for template ‘%s’", n, name);
+
+	return args[n - 1];
+}
+
+static void expand_template(struct frame *f, struct template *t,
+			    char **args, size_t argc)
+{
+	size_t i;
+
+	for (i = 0; i < t->cnum; i++)
+		push_byte(f, substitute(t->code[i], args, argc, t->name));
+	f->cnum = f->num;
+
+	for (i = 0; i < t->dnum; i++)
+		push_byte(f, substitute(t->data[i], args, argc, t->name));
+}
+
+static void flush_frame(struct frame *f)
+{
+	struct frame_rec *r;
+	uint8_t packed[(MAX_BYTES + 7) / 8] = { 0 };
+	size_t i;
+
+	if (pending_num == MAX_FRAMES)
+		die("too many frames in one entry (max %d)", MAX_FRAMES);
+
+	r = &pending[pending_num++];
+	memset(r, 0, sizeof(*r));
+	r->delay = f->delay;
+	r->proto = f->proto;
+
+	if (f->isbit) {
+		/* one bit per bit, lsb first */
+		for (i = 0; i < f->bnum; i++)
+			packed[i / 8] |= f->bits[i] << (i % 8);
+
+		r->bits = intern_payload(packed, (f->bnum + 7) / 8);
+		r->bnum = f->bnum;
+		if (f->bnum > max_bits)
+			max_bits = f->bnum;
+		return;
+	}
+
+	if (!f->num)
+		die("empty frame");
+	if (!f->cnum)
+		die("frame without customer code");
+	if (f->cnum > MAX_BYTES || f->num - f->cnum > MAX_BYTES)
+		die("frame too long (max %d bytes)", MAX_BYTES);
+
+	r->code = intern_payload(f->bytes, f->cnum);
+	r->data = intern_payload(f->bytes + f->cnum, f->num - f->cnum);
+	r->cnum = f->cnum;
+	r->unum = f->num - f->cnum;
+	if (f->num > max_bytes)
+		max_bytes = f->num;
+}
+
+static void flush_entry(struct track *t, unsigned long start)
+{
+	struct track_entry *e;
+
+	t->entries = xrealloc(t->entries, (t->num + 1) * sizeof(*t->entries));
+	e = &t->entries[t->num++];
+
+	e->start = start;
+	e->fnum = pending_num;
+	e->frames = xrealloc(NULL, pending_num * sizeof(*pending));
+	memcpy(e->frames, pending, pending_num * sizeof(*pending));
+
+	pending_num = 0;
+}
+
+static void flush_rule(struct track *t, struct rule_rec *r)
+{
+	size_t i;
+
+	for (i = 0; i < pending_num; i++)
+		pending[i].days = t->ondays;
+
+	r->base.frame = intern_frames(pending, pending_num);
+	r->base.fnum  = pending_num;
+	r->base.days  = t->ondays;
+
+	rules[rule_num++] = *r;
+	rule_days |= t->ondays;
+	all_days |= t->ondays;
+	t->rule_num++;
+
+	pending_num = 0;
+}
+
+/* every <minutes> <from> <to> */
+static void parse_rule(struct rule_rec *r, char **tok, size_t n)
+{
+	if (n < 4)
+		die("‘every’ needs a period, a start and an end");
+	if (rule_num == MAX_RULES)
+		die("too many ‘every’ (max %d)", MAX_RULES);
+
+	memset(r, 0, sizeof(*r));
+	r->period = parse_uint(tok[1], MAX_PERIOD, "period") * 60;
+	r->base.start = parse_time(tok[2]);
+	r->end = parse_time(tok[3]);
+
+	if (!r->period)
+		die("invalid period ‘%s’", tok[1]);
+	if (r->end < r->base.start)
+		die("‘%s’ is before ‘%s’", tok[3], tok[2]);
+}
+
+/* returns 1 if the frame continues on the following lines */
+static int parse_frame(struct frame *f, char **tok, size_t n)
+{
+	struct template *t;
+	size_t i;
+
+	memset(f, 0, sizeof(*f));
+
+	if (n && find_protocol(tok[0]) >= 0) {
+		f->proto = find_protocol(tok[0]);
+		tok++;
+		n--;
+	}
+
+	if (!n)
+		die("missing frame");
+
+	if (!strcmp(tok[0], "B")) {
+		if (n == 1)
+			die("missing bits");
+
+		if (n - 1 > MAX_BYTES)
+			die("too many bits (max %d)", MAX_BYTES);
+
+		f->isbit = 1;
+		for (i = 1; i < n; i++) {
+			if (strcmp(tok[i], "0") && strcmp(tok[i], "1"))
+				die("invalid bit ‘%s’", tok[i]);
+			f->bits[f->bnum++] = tok[i][0] - '0';
+		}
+	} else if ((t = find_template(tok[0]))) {
+		expand_template(f, t, tok + 1, n - 1);
+	} else {
+		for (i = 0; i < n; i++)
+			push_byte(f, tok[i]);
+		f->cnum = f->num;
+		return 1;
+	}
+
+	return 0;
+}
+
+static uint8_t parse_days(char **tok, size_t n)
+{
+	uint8_t days = 0;
+	size_t i;
+
+	if (n != 7)
+		die("‘on’ needs 7 days, got %zu", n);
+
+	for (i = 0; i < n; i++) {
+		if (strcmp(tok[i], "0") && strcmp(tok[i], "1"))
+			die("invalid day flag ‘%s’", tok[i]);
+		days = (days << 1) | (tok[i][0] - '0');
+	}
+
+	return days;
+}
+
+static void define_template(char **tok, size_t n)
+{
+	struct template *t;
+
+	if (n < 2)
+		die("missing template name");
+	if (find_template(tok[1]) || find_protocol(tok[1]) >= 0 ||
+	    !strcmp(tok[1], "B"))
+		die("template ‘%s’ is already defined", tok[1]);
+
+	templates = xrealloc(templates, ++template_num * sizeof(*templates));
+	t = &templates[template_num - 1];
+	memset(t, 0, sizeof(*t));
+
+	t->name = xstrdup(tok[1]);
+	push_tokens(&t->code, &t->cnum, tok + 2, n - 2);
+}
+
+static struct track *new_track(uint8_t ondays)
+{
+	struct track *t;
+
+	tracks = xrealloc(tracks, (track_num + 1) * sizeof(*tracks));
+	t = &tracks[track_num++];
+	memset(t, 0, sizeof(*t));
+	t->ondays = ondays;
+
+	return t;
+}
+
+/* every ‘on’ starts a track of its own */
+static void parse_schedule(FILE *fp)
+{
+	char line[4096], *tok[MAX_TOKENS];
+	struct template *defining = NULL;
+	struct frame frame;
+	struct track *t = NULL;
+	struct rule_rec rule;
+	int parsing = 0, continuable = 0, is_rule = 0;
+	unsigned long prev = 0, start = 0;
+	size_t n;
+
+	while (fgets(line, sizeof(line), fp)) {
+		lineno++;
+
+		if (!strchr(line, '\n') && !feof(fp))
+			die("line too long");
+
+		int indented = line[0] == '\t' || line[0] == ' ';
+
+		if (line[0] == '#')
+			continue;
+
+		n = split(line, tok);
+		if (!n) {
+			if (parsing) {
+				flush_frame(&frame);
+				if (is_rule)
+					flush_rule(t, &rule);
+				else
+					flush_entry(t, start);
+				parsing = 0;
+			}
+			defining = NULL;
+			continuable = 0;
+			continue;
+		}
+
+		if (!t && strcmp(tok[0], "on"))
+			die("expected ‘on’ before the schedule");
+
+		if (indented) {
+			if (defining)
+				push_tokens(&defining->data, &defining->dnum,
+					    tok, n);
+			else if (continuable)
+				for (size_t i = 0; i < n; i++)
+					push_byte(&frame, tok[i]);
+			else
+				die("data without a frame");
+			continue;
+		}
+
+		if (defining)
+			die("missing empty line after template ‘%s’",
+			    defining->name);
+
+		if (!strcmp(tok[0], "on")) {
+			if (parsing)
+				die("missing empty line before ‘on’");
+			if (t && !t->num && !t->rule_num)
+				die("no entry after the previous ‘on’");
+			t = new_track(parse_days(tok + 1, n - 1));
+			continue;
+		}
+
+		if (!strcmp(tok[0], "define")) {
+			if (parsing)
+				die("missing empty line before ‘define’");
+			define_template(tok, n);
+			defining = &templates[template_num - 1];
+			continue;
+		}
+
+		if (!parsing && !strcmp(tok[0], "every")) {
+			parse_rule(&rule, tok, n);
+			is_rule = 1;
+			parsing = 1;
+			continuable = parse_frame(&frame, tok + 4, n - 4);
+		} else if (!parsing) {
+			start = parse_time(tok[0]);
+			if (t->num && start <= prev)
+				die("‘%s’ is not after the previous entry",
+				    tok[0]);
+			prev = start;
+
+			is_rule = 0;
+			parsing = 1;
+			continuable = parse_frame(&frame, tok + 1, n - 1);
+		} else {
+			flush_frame(&frame);
+			continuable = parse_frame(&frame, tok + 1, n - 1);
+			frame.delay = parse_uint(tok[0], MAX_DELAY, "delay");
+		}
+	}
+
+	if (ferror(fp))
+		die("failed to read");
+
+	if (parsing) {
+		flush_frame(&frame);
+		if (is_rule)
+			flush_rule(t, &rule);
+		else
+			flush_entry(t, start);
+	}
+
+	lineno = 0;
+	if (!t)
+		die("%s: missing ‘on’", input);
+	if (!t->num && !t->rule_num)
+		die("%s: no entry after the last ‘on’", input);
+}
+
+static void build_wheel(void)
+{
+	size_t d, b, i, k, pos;
+
+	/* one more, a schedule may be made of rules only */
+	events = xrealloc(NULL, (entry_num * WHEEL_DAYS + 1) * sizeof(*events));
+
+	for (d = 0; d < WHEEL_DAYS; d++) {
+		wheel_day[d] = event_num;
+		for (i = 0; i < entry_num; i++)
+			if (entries[i].days & (64 >> d))
+				events[event_num++] = i;
+	}
+	wheel_day[WHEEL_DAYS] = event_num;
+
+	if (event_num > MAX_OFFSET)
+		die("schedule exceeds %d entries a week", MAX_OFFSET);
+
+	for (d = 0; d < WHEEL_DAYS; d++) {
+		pos = wheel_day[d];
+
+		for (b = 0; b < WHEEL_BUCKETS; b++) {
+			while (pos < wheel_day[d + 1] &&
+			       entries[events[pos]].start < b * 3600)
+				pos++;
+			wheel_bucket[d][b] = pos;
+		}
+
+		/* 7 is the same day of the next week */
+		wheel_next_day[d] = 0;
+		for (k = 1; k <= WHEEL_DAYS; k++) {
+			size_t n = (d + k) % WHEEL_DAYS;
+
+			if (wheel_day[n] != wheel_day[n + 1] ||
+			    rule_days & (64 >> n)) {
+				wheel_next_day[d] = k;
+				break;
+			}
+		}
+	}
+}
+
+/*
+ * k-way merge of the tracks, entries of the same second become one entry,
+ * each frame keeps the weekdays of its track
+ */
+static void merge_tracks(void)
+{
+	size_t *pos = xrealloc(NULL, track_num * sizeof(*pos));
+	struct entry_rec *e;
+	uint32_t start;
+	uint8_t days;
+	size_t i, j;
+
+	memset(pos, 0, track_num * sizeof(*pos));
+
+	while (39) {
+		start = UINT32_MAX;
+		for (i = 0; i < track_num; i++)
+			if (pos[i] < tracks[i].num &&
+			    tracks[i].entries[pos[i]].start < start)
+				start = tracks[i].entries[pos[i]].start;
+
+		if (start == UINT32_MAX)
+			break;
+
+		days = 0;
+		for (i = 0; i < track_num; i++) {
+			struct track_entry *te;
+
+			if (pos[i] == tracks[i].num)
+				continue;
+
+			te = &tracks[i].entries[pos[i]];
+			if (te->start != start)
+				continue;
+
+			if (pending_num + te->fnum > MAX_FRAMES)
+				die("too many frames at %02u:%02u:%02u "
+				    "(max %d)", start / 3600,
+				    start / 60 % 60, start % 60, MAX_FRAMES);
+
+			for (j = 0; j < te->fnum; j++) {
+				pending[pending_num] = te->frames[j];
+				pending[pending_num++].days = tracks[i].ondays;
+			}
+
+			days |= tracks[i].ondays;
+			pos[i]++;
+		}
+
+		if (entry_num == MAX_OFFSET)
+			die("too many entries (max %d)", MAX_OFFSET);
+
+		entries = xrealloc(entries, (entry_num + 1) * sizeof(*entries));
+		e = &entries[entry_num++];
+
+		e->start = start;
+		e->frame = intern_frames(pending, pending_num);
+		e->fnum  = pending_num;
+		e->days  = days;
+
+		all_days |= days;
+		pending_num = 0;
+	}
+
+	free(pos);
+}
+
+static const char *def_header =
+"/* Automatically generated by schedule-signal <barroit> */\n"
+"\n"
+"#ifndef SIGNAL_SCHEDULE_DEF_H\n"
+"#define SIGNAL_SCHEDULE_DEF_H\n"
+"\n"
+"#include <stdint.h>\n"
+"#include <stddef.h>\n"
+"\n"
+"#define SCHEDULE_MAGIC   0x%08X\n"
+"#define SCHEDULE_VERSION %d\n"
+"\n"
+"/* largest frame of this schedule, may be raised with -D */\n"
+"#ifndef FRAME_BYTES_MAX\n"
+"#define FRAME_BYTES_MAX  %zu\n"
+"#endif\n"
+"#ifndef FRAME_BITS_MAX\n"
+"#define FRAME_BITS_MAX   %zu\n"
+"#endif\n"
+"\n"
+"/*\n"
+" * a schedule image is this header, followed by signal_schedule[entries],\n"
+" * frame_info[frames], schedule_wheel, uint16_t event[events],\n"
+" * schedule_rule[rules] and the payload, all little endian\n"
+" *\n"
+" * crc is the crc32 of the image from size to the end, sequence is not\n"
+" * covered, it is bumped by each upload to tell the newer slot\n"
+" */\n"
+"struct schedule_header {\n"
+"	uint32_t magic;\n"
+"	uint32_t sequence;\n"
+"	uint32_t crc;\n"
+"	uint32_t size;\n"
+"	uint16_t version;\n"
+"	uint16_t entries;\n"
+"	uint16_t frames;\n"
+"	uint16_t payload;\n"
+"	uint16_t events;\n"
+"	uint8_t ondays; /* any day of any entry */\n"
+"	uint8_t rules;\n"
+"} __attribute__((packed));\n"
+"\n"
+"#define SCHEDULE_RULES_MAX %d\n"
+"\n"
+"#define WHEEL_DAYS    %d\n"
+"#define WHEEL_BUCKETS %d\n"
+"\n"
+"/*\n"
+" * the weekly time-wheel, day 0 is monday\n"
+" *\n"
+" * event[day[d]] to event[day[d + 1] - 1] are the entries of day d in\n"
+" * time order, bucket[d][h] is the first event of day d at or after hour\n"
+" * h, and next_day[d] is the number of days to the next day having\n"
+" * entries or rules, 7 is the same day of the next week, 0 is none at all\n"
+" */\n"
+"struct schedule_wheel {\n"
+"	uint16_t day[WHEEL_DAYS + 1];\n"
+"	uint16_t bucket[WHEEL_DAYS][WHEEL_BUCKETS];\n"
+"	uint8_t next_day[WHEEL_DAYS];\n"
+"	uint8_t reserved;\n"
+"} __attribute__((packed));\n"
+"\n"
+"/* code, data and bits are payload offsets, bits are packed lsb first */\n"
+"struct frame_info {\n"
+"	uint16_t code;\n"
+"	uint16_t data;\n"
+"	uint16_t bits;\n"
+"	uint8_t cnum;\n"
+"	uint8_t unum;\n"
+"	uint8_t bnum;\n"
+"	uint8_t delay;\n"
+"	uint8_t proto;\n"
+"	uint8_t days;\n"
+"} __attribute__((packed));\n"
+"\n"
+"/*\n"
+" * frame is the index of the first frame in the frame table, days are the\n"
+" * weekdays of any of its frames, in get_day_of_week() bits\n"
+" */\n"
+"struct signal_schedule {\n"
+"	uint32_t start;\n"
+"	uint16_t frame;\n"
+"	uint8_t fnum;\n"
+"	uint8_t days;\n"
+"} __attribute__((packed));\n"
+"\n"
+"/*\n"
+" * ‘every <period> <from> <to>’, sent at from, from + period, ... up to\n"
+" * to, on the days of base\n"
+" */\n"
+"struct schedule_rule {\n"
+"	struct signal_schedule base; /* base.start is from */\n"
+"	uint32_t end;\n"
+"	uint32_t period; /* seconds */\n"
+"} __attribute__((packed));\n"
+"\n"
+"/**\n"
+" * In this case, using 'typedef' is appropriate since we don’t access the\n"
+" * fields in the 'end-user API'; we simply use these structs as a type.\n"
+" */\n"
+"typedef struct frame_info frame_info_t;\n"
+"typedef struct signal_schedule signal_schedule_t;\n"
+"\n"
+"#endif /* SIGNAL_SCHEDULE_DEF_H */\n";
+
+static void put8(struct buf *b, uint8_t v)
+{
+	buf_putn(b, (const char *)&v, 1);
+}
+
+static void put16(struct buf *b, uint16_t v)
+{
+	put8(b, v);
+	put8(b, v >> 8);
+}
+
+static void put32(struct buf *b, uint32_t v)
+{
+	put16(b, v);
+	put16(b, v >> 16);
+}
+
+static void set32(struct buf *b, size_t off, uint32_t v)
+{
+	size_t i;
+
+	for (i = 0; i < 4; i++)
+		b->s[off + i] = v >> (i * 8);
+}
+
+/* the usual crc32, same as esp_rom_crc32_le(0, ...) */
+static uint32_t crc32(const uint8_t *p, size_t n)
+{
+	uint32_t crc = ~0U;
+	size_t i;
+	int k;
+
+	for (i = 0; i < n; i++) {
+		crc ^= p[i];
+		for (k = 0; k < 8; k++)
+			crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+	}
+
+	return ~crc;
+}
+
+static void make_blob(struct buf *blob)
+{
+	size_t i;
+
+	put32(blob, SCHEDULE_MAGIC);
+	put32(blob, 0);
+	put32(blob, 0);
+	put32(blob, 0);
+	put16(blob, SCHEDULE_VERSION);
+	put16(blob, entry_num);
+	put16(blob, frame_num);
+	put16(blob, payload.len);
+	put16(blob, event_num);
+	put8(blob, all_days);
+	put8(blob, rule_num);
+
+	for (i = 0; i < entry_num; i++) {
+		put32(blob, entries[i].start);
+		put16(blob, entries[i].frame);
+		put8(blob, entries[i].fnum);
+		put8(blob, entries[i].days);
+	}
+
+	for (i = 0; i < frame_num; i++) {
+		put16(blob, frames[i].code);
+		put16(blob, frames[i].data);
+		put16(blob, frames[i].bits);
+		put8(blob, frames[i].cnum);
+		put8(blob, frames[i].unum);
+		put8(blob, frames[i].bnum);
+		put8(blob, frames[i].delay);
+		put8(blob, frames[i].proto);
+		put8(blob, frames[i].days);
+	}
+
+	for (i = 0; i <= WHEEL_DAYS; i++)
+		put16(blob, wheel_day[i]);
+	for (i = 0; i < WHEEL_DAYS * WHEEL_BUCKETS; i++)
+		put16(blob, wheel_bucket[i / WHEEL_BUCKETS][i % WHEEL_BUCKETS]);
+	for (i = 0; i < WHEEL_DAYS; i++)
+		put8(blob, wheel_next_day[i]);
+	put8(blob, 0);
+
+	for (i = 0; i < event_num; i++)
+		put16(blob, events[i]);
+
+	for (i = 0; i < rule_num; i++) {
+		put32(blob, rules[i].base.start);
+		put16(blob, rules[i].base.frame);
+		put8(blob, rules[i].base.fnum);
+		put8(blob, rules[i].base.days);
+		put32(blob, rules[i].end);
+		put32(blob, rules[i].period);
+	}
+
+	buf_putn(blob, payload.s, payload.len);
+
+	if (blob->len > UINT32_MAX)
+		die("schedule image too large");
+
+	set32(blob, CRC_OFFSET, blob->len);
+	set32(blob, CRC_OFFSET - 4,
+	      crc32((uint8_t *)blob->s + CRC_OFFSET, blob->len - CRC_OFFSET));
+}
+
+static void dump_blob(struct buf *out, const struct buf *blob)
+{
+	static const char *hex = "0123456789ABCDEF";
+	char cell[8] = " 0x00,";
+	size_t i;
+
+	for (i = 0; i < blob->len; i++) {
+		uint8_t v = blob->s[i];
+
+		if (i % 12 == 0)
+			buf_putn(out, "\t", 1);
+
+		cell[3] = hex[v >> 4];
+		cell[4] = hex[v & 0xF];
+		buf_putn(out, i % 12 ? cell : cell + 1, i % 12 ? 6 : 5);
+
+		if (i % 12 == 11 || i + 1 == blob->len)
+			buf_putn(out, "\n", 1);
+	}
+}
+
+static const char *path_basename(const char *path)
+{
+	const char *p = strrchr(path, '/');
+	return p ? p + 1 : path;
+}
+
+static void write_image(const char *path, const struct buf *blob)
+{
+	FILE *fp = fopen(path, "wb");
+
+	if (!fp)
+		die("cannot open output file ‘%s’", path);
+
+	if (fwrite(blob->s, 1, blob->len, fp) != blob->len || fclose(fp))
+		die("failed to write ‘%s’", path);
+}
+
+static void write_file(const char *path, const char *fmt, ...)
+{
+	va_list ap;
+	FILE *fp = fopen(path, "w");
+
+	if (!fp)
+		die("cannot open output file ‘%s’", path);
+
+	va_start(ap, fmt);
+	vfprintf(fp, fmt, ap);
+	va_end(ap);
+
+	if (fclose(fp))
+		die("failed to write ‘%s’", path);
+}
+
+int main(int argc, char **argv)
+{
+	FILE *fp;
+	struct buf blob = { 0 }, text = { 0 };
+	int i;
+
+	if (argc < 5)
+		die("usage: make-schedule <def-header> <list-header> <image> "
+		    "<input>...");
+
+	for (i = 4; i < argc; i++) {
+		input = argv[i];
+		fp = fopen(input, "r");
+		if (!fp)
+			die("cannot access input file ‘%s’", input);
+
+		/* templates are local to their file */
+		template_num = 0;
+		parse_schedule(fp);
+		fclose(fp);
+	}
+
+	merge_tracks();
+	build_wheel();
+	make_blob(&blob);
+	dump_blob(&text, &blob);
+	write_image(argv[3], &blob);
+
+	write_file(argv[1], def_header, SCHEDULE_MAGIC, SCHEDULE_VERSION,
+		   max_bytes, max_bits, MAX_RULES, WHEEL_DAYS, WHEEL_BUCKETS);
+
+	write_file(argv[2],
+		   "/* Automatically generated by schedule-signal <barroit> */\n"
+		   "\n"
+		   "#ifdef SIGNAL_SCHEDULE_AUTOGEN_H\n"
+		   "#error \"The signal schedule should be included only once\"\n"
+		   "#endif\n"
+		   "\n"
+		   "#define SIGNAL_SCHEDULE_AUTOGEN_H\n"
+		   "\n"
+		   "#include \"%s\"\n"
+		   "\n"
+		   "/* %zu tracks, %zu entries, %zu frames, "
+		   "%zu bytes of payload */\n"
+		   "static const uint8_t schedule_blob[] "
+		   "__attribute__((aligned(4))) = {\n"
+		   "%s"
+		   "};\n",
+		   path_basename(argv[1]), track_num, entry_num, frame_num,
+		   payload.len, text.s);
+
+	return 0;
+}
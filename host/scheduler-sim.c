@@ -0,0 +1,345 @@
+/****************************************************************************
+**
+** Copyright 2024 Jiamu Sun
+** Contact: barroit@linux.com
+**
+** This file is part of livaut.
+**
+** livaut is free software: you can redistribute it and/or modify it
+** under the terms of the GNU General Public License as published by the
+** Free Software Foundation, either version 3 of the License, or (at your
+** option) any later version.
+**
+** livaut is distributed in the hope that it will be useful, but
+** WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+** General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License along
+** with livaut. If not, see <https://www.gnu.org/licenses/>.
+**
+****************************************************************************/
+
+/*
+ * runs schedule_signal() against a virtual clock, weeks of operation take
+ * a fraction of a second, every send, skipped schedule, wake-up and sleep
+ * is reported on stdout, the log of the action goes to stderr
+ *
+ * the week starts on monday 00:00:00, a deep sleep is a reboot, the state
+ * in rtc memory survives, it takes boot-seconds from a wake-up until the
+ * action runs again (boot, wifi and sntp)
+ *
+ * nvs is a single blob in memory, which survives the reboots
+ *
+ * a light sleep longer than cut-ms is ended after cut-ms by a jumper
+ * wake-up, the jumper is left as it was, as noise on the pin would
+ *
+ * usage: scheduler-sim [days [boot-seconds [start-second [cut-ms]]]]
+ */
+
+#include "execute-action.h"
+#include "transmit.h"
+#include "schedule.h"
+#include "ir-protocol.h"
+#include "sntp.h"
+#include "power.h"
+#include "punctuality.h"
+#include "nvs.h"
+#include "nvs_flash.h"
+#include "termio.h"
+#include <inttypes.h>
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TAG "scheduler-sim"
+
+#define DEFAULT_DAYS 14
+#define DEFAULT_BOOT 1
+
+/* vTaskDelay() of do_execute_action() after EXEC_AGAIN */
+#define EXECUTOR_DELAY 1500
+
+ACTION_DECLARATION(schedule_signal);
+
+static const char *weekday_name[] = {
+	"mon", "tue", "wed", "thu", "fri", "sat", "sun",
+};
+
+struct sim_stats {
+	u64 wakeups;
+	u64 resumes;
+	u64 frames;
+	u64 skipped;
+	u64 cuts;   /* light sleeps ended by a jumper wake-up */
+	u64 awake;  /* ms */
+	u64 asleep; /* ms */
+};
+
+static u64 now;   /* ms since monday 00:00:00 of the first week */
+static u64 timer; /* seconds, set by start_long_sleep() */
+static u64 wake_at;
+static u64 end;
+static u64 cut;   /* ms */
+static jmp_buf reboot;
+static struct sim_stats stats;
+
+static u8 nvs_blob[256];
+static size_t nvs_size;
+
+static void print_time(u64 ms)
+{
+	u64 sec = ms / 1000 % 86400;
+
+	printf("day %3" PRIu64 " %s " HH_MM_SS ".%03" PRIu64 "  ",
+	       ms / 86400000, weekday_name[ms / 86400000 % 7],
+	       sec_to_hour_d(sec), sec_to_min_d(sec), sec_to_sec_d(sec),
+	       ms % 1000);
+}
+
+u8 get_weekday(void)
+{
+	return now / 86400000 % 7;
+}
+
+u8 get_day_of_week(void)
+{
+	return 64 >> get_weekday();
+}
+
+u64 get_seconds_of_day(void)
+{
+	return now / 1000 % 86400;
+}
+
+u32 get_ms_of_day(void)
+{
+	return now % 86400000;
+}
+
+/* as tm_year * 366 + tm_yday, the years from 1900 on are 365 days long */
+u32 get_day_stamp(void)
+{
+	u64 day = now / 86400000;
+
+	return day / 365 * 366 + day % 365;
+}
+
+int is_clock_valid(void)
+{
+	return 1;
+}
+
+int is_clock_trusted_after(u64 seconds)
+{
+	return 1;
+}
+
+void start_long_sleep(u64 seconds)
+{
+	timer = seconds;
+	start_deep_sleep();
+}
+
+int start_light_sleep(u64 ms)
+{
+	int is_cut = cut && ms > cut;
+
+	if (is_cut) {
+		ms = cut;
+		stats.cuts++;
+	}
+
+	stats.awake += now - wake_at;
+	stats.asleep += ms;
+
+	now += ms;
+	wake_at = now;
+
+	return is_cut;
+}
+
+void start_deep_sleep(void)
+{
+	u64 step = CONFIG_SCHEDULER_SUSPEND_LIMIT * 60;
+	u64 steps = (timer + step - 1) / step;
+	u64 ms = timer * 1000;
+
+	if (ms > end - now)
+		ms = end - now;
+
+	stats.awake += now - wake_at;
+	stats.asleep += ms;
+
+	print_time(now);
+	printf("sleep %" PRIu64 " s in %" PRIu64 " steps\n", timer, steps);
+
+	/* wake-ups of resume_long_sleep(), back to sleep before the app */
+	stats.resumes += steps - 1;
+
+	now += timer * 1000;
+	longjmp(reboot, 1);
+}
+
+int setup_transmitter(void)
+{
+	return 0;
+}
+
+int teardown_transmitter(void)
+{
+	return 0;
+}
+
+int wait_transmit_done(void)
+{
+	return 0;
+}
+
+int transmit_signal(const frame_info_t *frame)
+{
+	print_time(now);
+	printf("send  %s, %u bytes, %u bits\n",
+	       get_ir_protocol(frame->proto)->name,
+	       frame->cnum + frame->unum, frame->bnum);
+
+	stats.frames++;
+	now += frame->delay;
+	return 0;
+}
+
+int is_nvs_ready(void)
+{
+	return 1;
+}
+
+esp_err_t nvs_open(const char *name, nvs_open_mode_t mode,
+		   nvs_handle_t *handle)
+{
+	*handle = 1;
+	return ESP_OK;
+}
+
+void nvs_close(nvs_handle_t handle)
+{
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char *key, void *value,
+		       size_t *length)
+{
+	if (!nvs_size)
+		return ESP_ERR_NVS_NOT_FOUND;
+
+	if (*length > nvs_size)
+		*length = nvs_size;
+	memcpy(value, nvs_blob, *length);
+	return ESP_OK;
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char *key,
+		       const void *value, size_t length)
+{
+	if (length > sizeof(nvs_blob))
+		die(TAG, "nvs blob of %zu bytes", length);
+
+	memcpy(nvs_blob, value, length);
+	nvs_size = length;
+
+	print_time(now);
+	printf("flush %s\n", key);
+	return ESP_OK;
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle)
+{
+	return ESP_OK;
+}
+
+static void print_stats(u64 days)
+{
+	printf("\n%" PRIu64 " wake-ups, %.1f per week, and %" PRIu64
+	       " steps of longer sleeps\n", stats.wakeups,
+	       stats.wakeups * 7.0 / days, stats.resumes);
+	printf("%" PRIu64 " frames sent, %" PRIu64 " schedules skipped\n",
+	       stats.frames, stats.skipped);
+	printf("%" PRIu64 " light sleeps cut short\n", stats.cuts);
+	printf("awake %.1f s, asleep %.1f s, %.3f%% awake\n",
+	       stats.awake / 1000.0, stats.asleep / 1000.0,
+	       stats.awake * 100.0 / (stats.awake + stats.asleep));
+}
+
+/* skips are counted where the action records them */
+static void report_skips(void)
+{
+	struct punctuality p;
+
+	get_punctuality(&p);
+	while (stats.skipped < p.skipped) {
+		stats.skipped++;
+		print_time(now);
+		puts("skip");
+	}
+}
+
+int main(int argc, char **argv)
+{
+	u64 days = argc > 1 ? strtoull(argv[1], NULL, 10) : DEFAULT_DAYS;
+	u64 boot = argc > 2 ? strtoull(argv[2], NULL, 10) : DEFAULT_BOOT;
+
+	if (!days)
+		die(TAG, "days must be positive");
+
+	end = days * 86400000;
+
+	/* keeps the report in order with the log on stderr */
+	setvbuf(stdout, NULL, _IOLBF, 0);
+
+	now = argc > 3 ? strtoull(argv[3], NULL, 10) * 1000 : 0;
+	cut = argc > 4 ? strtoull(argv[4], NULL, 10) : 0;
+	print_time(now);
+	puts("boot");
+
+	if (setjmp(reboot)) {
+		if (now >= end)
+			goto out;
+
+		print_time(now);
+		puts("wake");
+		now += boot * 1000;
+	}
+
+	stats.wakeups++;
+	wake_at = now;
+	load_schedule();
+	load_punctuality();
+
+	if (schedule_signal_setup())
+		die(TAG, "setup failed");
+
+	while (now < end) {
+		enum action_result res = schedule_signal();
+
+		report_skips();
+
+		switch (res) {
+		case EXEC_ERROR:
+			die(TAG, "schedule_signal() failed");
+		case EXEC_RETRY:
+			/* a skip, or the light sleep up to a due schedule */
+			break;
+		case EXEC_AGAIN:
+			now += EXECUTOR_DELAY;
+			break;
+		case EXEC_DONE:
+			die(TAG, "schedule_signal() is done");
+		}
+	}
+
+	stats.awake += now - wake_at;
+
+out:
+	print_stats(days);
+	print_punctuality();
+	return 0;
+}
@@ -0,0 +1,62 @@
+#!/usr/bin/env python3
+# SPDX-License-Identifier: GPL-3.0-or-later
+#
+# uploads a schedule image (make-schedule ... <image>) to the board running
+# the upload_schedule action, see src/action/upload-schedule.c
+#
+# usage: upload-schedule.py <port> <image> [baud]
+
+import sys
+import time
+import serial
+
+HEADER_SIZE = 28
+TAG = b'upload_schedule: '
+
+def wait_for(port, timeout, *words):
+	deadline = time.monotonic() + timeout
+
+	while time.monotonic() < deadline:
+		line = port.readline()
+		if not line:
+			continue
+
+		sys.stdout.write(line.decode(errors='replace'))
+
+		idx = line.find(TAG)
+		if idx == -1:
+			continue
+
+		msg = line[idx + len(TAG):]
+		for w in words:
+			if msg.startswith(w):
+				return w
+
+	return None
+
+def main():
+	if len(sys.argv) < 3:
+		sys.exit(f'usage: {sys.argv[0]} <port> <image> [baud]')
+
+	image = open(sys.argv[2], 'rb').read()
+	baud = int(sys.argv[3]) if len(sys.argv) > 3 else 115200
+
+	with serial.Serial(sys.argv[1], baud, timeout=1) as port:
+		print('waiting for the board, set the upload jumper')
+
+		# the board polls for the header, once it has one no more copies
+		# go out, they would end up in the image if the erase outlasts
+		# the flush before 'accepted'
+		while True:
+			port.write(image[:HEADER_SIZE])
+			if wait_for(port, 3, b'received'):
+				break
+
+		if wait_for(port, 30, b'accepted', b'rejected') != b'accepted':
+			sys.exit('image rejected')
+
+		port.write(image[HEADER_SIZE:])
+		if wait_for(port, 30, b'done', b'failed') != b'done':
+			sys.exit('upload failed')
+
+main()
@@ -1,15 +1,57 @@
+# one track per appliance, tracks are merged into one timeline
 set(SCHEDULE_INPUT "${CMAKE_SOURCE_DIR}/schedule.in")
 set(SCHEDULE_DEF "signal-schedule-def.h")
 set(SCHEDULE_LIST "signal-schedule.h")
-set(SCHEDULE_EXEC "${CMAKE_SOURCE_DIR}/make-schedule")
+set(SCHEDULE_IMAGE "schedule.bin")
+set(SCHEDULE_SOURCE "${CMAKE_SOURCE_DIR}/host/make-schedule.c")
+set(SCHEDULE_EXEC "${CMAKE_CURRENT_BINARY_DIR}/make-schedule")
+set(FOOTPRINT_SOURCE "${CMAKE_SOURCE_DIR}/host/footprint.c")
+set(FOOTPRINT_EXEC "${CMAKE_CURRENT_BINARY_DIR}/footprint")
+set(FOOTPRINT_REPORT "footprint.txt")
+# the structures measured by footprint.c
+file(GLOB FOOTPRINT_HEADERS ${COMPONENT_DIR}/*.h)
 
-add_custom_command(OUTPUT ${SCHEDULE_DEF} ${SCHEDULE_LIST}
-		   COMMAND ${SCHEDULE_EXEC} ${SCHEDULE_INPUT}
-		   ${SCHEDULE_DEF} ${SCHEDULE_LIST}
-		   DEPENDS ${SCHEDULE_INPUT})
+# the generator runs on the build machine, not on the target
+find_program(HOST_CC NAMES cc gcc clang)
+if(NOT HOST_CC)
+	message(FATAL_ERROR "no host c compiler found to build make-schedule")
+endif()
 
-add_custom_target(schedule DEPENDS ${SCHEDULE_DEF} ${SCHEDULE_LIST})
+add_custom_command(OUTPUT ${SCHEDULE_EXEC}
+		   COMMAND ${HOST_CC} -std=gnu17 -O2 -o ${SCHEDULE_EXEC}
+		   ${SCHEDULE_SOURCE}
+		   DEPENDS ${SCHEDULE_SOURCE})
+
+add_custom_command(OUTPUT ${SCHEDULE_DEF} ${SCHEDULE_LIST} ${SCHEDULE_IMAGE}
+		   COMMAND ${SCHEDULE_EXEC} ${SCHEDULE_DEF} ${SCHEDULE_LIST}
+		   ${SCHEDULE_IMAGE} ${SCHEDULE_INPUT}
+		   DEPENDS ${SCHEDULE_INPUT} ${SCHEDULE_EXEC})
+
+# sizes come from the same headers the firmware is built with
+add_custom_command(OUTPUT ${FOOTPRINT_EXEC}
+		   COMMAND ${HOST_CC} -std=gnu17 -O2
+		   -I${CMAKE_SOURCE_DIR}/host/fake -I${COMPONENT_DIR}
+		   -I${CMAKE_CURRENT_BINARY_DIR} -o ${FOOTPRINT_EXEC}
+		   ${FOOTPRINT_SOURCE}
+		   DEPENDS ${FOOTPRINT_SOURCE} ${SCHEDULE_DEF} ${SCHEDULE_LIST}
+		   ${FOOTPRINT_HEADERS})
+
+# the budgets are arguments, menuconfig changing them reruns the check
+idf_build_get_property(SDKCONFIG_FILE SDKCONFIG)
+
+# fails the build when the schedule or its buffers are over budget
+add_custom_command(OUTPUT ${FOOTPRINT_REPORT}
+		   COMMAND ${FOOTPRINT_EXEC} ${CONFIG_FOOTPRINT_FLASH_BUDGET}
+		   ${CONFIG_FOOTPRINT_RAM_BUDGET} ${CONFIG_FOOTPRINT_RTC_BUDGET}
+		   > ${FOOTPRINT_REPORT}
+		   DEPENDS ${FOOTPRINT_EXEC} ${SDKCONFIG_FILE})
+
+add_custom_target(schedule
+		  DEPENDS ${SCHEDULE_DEF} ${SCHEDULE_LIST} ${SCHEDULE_IMAGE}
+		  ${FOOTPRINT_REPORT})
 add_dependencies(${COMPONENT_LIB} schedule)
 
 set_property(DIRECTORY ${COMPONENT_DIR} APPEND PROPERTY
-	     ADDITIONAL_CLEAN_FILES ${SCHEDULE_OUTPUT})
+	     ADDITIONAL_CLEAN_FILES ${SCHEDULE_DEF} ${SCHEDULE_LIST}
+	     ${SCHEDULE_IMAGE} ${SCHEDULE_EXEC} ${FOOTPRINT_EXEC}
+	     ${FOOTPRINT_REPORT})
@@ -25,12 +25,14 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/queue.h"
+#include "freertos/semphr.h"
 #include "termio.h"
 #include "sign.h"
 #include "rmt.h"
 #include "driver/gpio.h"
 #include "calc.h"
 #include "esp_timer.h"
+#include "power-lock.h"
 #include <string.h>
 
 /* fuck these damn long name */
@@ -44,6 +46,21 @@ static rmt_receive_config_t rmt_config;
 
 static int receive_result;
 
+/*
+ * with CONFIG_RECEIVER_LOW_POWER the rx channel is armed only from the
+ * first edge of a frame until a listen window passes without one, in
+ * between the rx gpio is a light sleep wake-up source
+ */
+static SemaphoreHandle_t first_edge;
+static volatile int is_listening;
+static int is_late;
+
+#ifdef CONFIG_RECEIVER_LOW_POWER
+# define LISTEN_WINDOW CONFIG_RECEIVER_LISTEN_WINDOW
+#else
+# define LISTEN_WINDOW 1500
+#endif
+
 static u64 frame_interval[2];
 static int is_interval_set[2];
 static u8 next_interv_idx;
@@ -63,7 +80,7 @@ static bool IRAM_ATTR copy_received_frame(rmt_channel_handle_t /* channel */,
 	/* xQueueSendFromISR returns bool  */
 	if (!xQueueSendFromISR(ctx, syms, &unblk))
 		receive_result = -1;
-	else
+	else if (is_listening) /* not when stop_listening() raced it */
 		receive_result = rmt_receive(rx_channel, rmt_symbols,
 					     sizeof(rmt_symbols), &rmt_config);
 
@@ -80,7 +97,15 @@ static void IRAM_ATTR receive_first_signal(void *)
 		next_interv_idx = !idx;
 	}
 
+	/* a level interrupt, enabled again after a frame is handled */
 	gpio_intr_disable(CONFIG_RMT_RX_GPIO);
+
+	if (!is_listening) {
+		BaseType_t unblk = pdFALSE;
+
+		xSemaphoreGiveFromISR(first_edge, &unblk);
+		portYIELD_FROM_ISR(unblk);
+	}
 }
 
 static rmt_rx_channel_config_t get_chan_conf(void)
@@ -118,27 +143,66 @@ static int setup_channel(void)
 	if (err)
 		return 1;
 
+	return 0;
+}
+
+static int start_listening(void)
+{
+	int err;
+
+	hold_power_lock(LOCK_RX_CAPTURE);
+
 	err = CE(rmt_enable(rx_channel));
 	if (err)
-		return 1;
+		goto err_enable;
 
+	err = CE(rmt_receive(rx_channel, rmt_symbols,
+			     sizeof(rmt_symbols), &rmt_config));
+	if (err)
+		goto err_receive;
+
+	is_listening = 1;
 	return 0;
+
+err_receive:
+	rmt_disable(rx_channel);
+err_enable:
+	release_power_lock(LOCK_RX_CAPTURE);
+	return 1;
+}
+
+static int stop_listening(void)
+{
+	int err;
+
+	if (!is_listening)
+		return 0;
+
+	is_listening = 0;
+	err = CE(rmt_disable(rx_channel));
+
+	release_power_lock(LOCK_RX_CAPTURE);
+
+	xSemaphoreTake(first_edge, 0);
+	gpio_intr_enable(CONFIG_RMT_RX_GPIO);
+
+	return err != 0;
 }
 
 static int setup_gpio_intr(void)
 {
 	int err;
 
-	err = CE(gpio_install_isr_service(ESP_INTR_FLAG_IRAM));
+	/* the isr service is installed by watch_jumper() */
+	err = CE(gpio_isr_handler_add(CONFIG_RMT_RX_GPIO, receive_first_signal, NULL));
 	if (err)
 		return 1;
 
-	err = CE(gpio_isr_handler_add(CONFIG_RMT_RX_GPIO, receive_first_signal, NULL));
+	/* ir receivers idle high, this also sets the interrupt type */
+	err = CE(gpio_wakeup_enable(CONFIG_RMT_RX_GPIO, GPIO_INTR_LOW_LEVEL));
 	if (err)
 		return 1;
 
-	gpio_set_intr_type(CONFIG_RMT_RX_GPIO, GPIO_INTR_NEGEDGE);
-
 	gpio_intr_enable(CONFIG_RMT_RX_GPIO);
 
 	return 0;
@@ -149,6 +213,7 @@ int receive_signal_setup(void)
 	int err;
 
 	incoming_symbols = xQueueCreate(8, sizeof(rmt_rx_done_event_data_t));
+	first_edge = xSemaphoreCreateBinary();
 
 	err = setup_channel();
 	if (err)
@@ -160,12 +225,11 @@ int receive_signal_setup(void)
 
 	make_aeha_receiver_config(&rmt_config);
 
-	err = CE(rmt_receive(rx_channel, rmt_symbols,
-			     sizeof(rmt_symbols), &rmt_config));
-	if (err)
-		return 1;
-
+#ifdef CONFIG_RECEIVER_LOW_POWER
 	return 0;
+#else
+	return start_listening();
+#endif
 }
 
 static void reset_frame_interval(void)
@@ -179,22 +243,23 @@ int receive_signal_teardown(void)
 {
 	int err;
 
-	err = CE(rmt_disable(rx_channel));
+	err = stop_listening();
 	if (err)
 		return 1;
+
 	err = CE(rmt_del_channel(rx_channel));
 	if (err)
 		return 1;
 
 	gpio_intr_disable(CONFIG_RMT_RX_GPIO);
+	gpio_wakeup_disable(CONFIG_RMT_RX_GPIO);
 
 	err = CE(gpio_isr_handler_remove(CONFIG_RMT_RX_GPIO));
 	if (err)
 		return 1;
 
-	gpio_uninstall_isr_service();
-
 	vQueueDelete(incoming_symbols);
+	vSemaphoreDelete(first_edge);
 
 	reset_frame_interval();
 
@@ -231,21 +296,49 @@ enum action_result receive_signal(void)
 		return EXEC_ERROR;
 	}
 
+	/* the cpu light sleeps here until an edge or the jumper check */
+	if (!is_listening) {
+		if (!xSemaphoreTake(first_edge, pdMS_TO_TICKS(1500)))
+			return EXEC_RETRY;
+
+		if (start_listening())
+			return EXEC_ERROR;
+		is_late = 1;
+	}
+
 	rmt_rx_done_event_data_t data;
-	if (!xQueueReceive(incoming_symbols, &data, pdMS_TO_TICKS(1500))) {
-		static u8 sign = SIGN_1 | SIGN_3 | SIGN_5 | SIGN_7;
+	if (!xQueueReceive(incoming_symbols, &data,
+			   pdMS_TO_TICKS(LISTEN_WINDOW))) {
 		reset_frame_interval();
+#ifdef CONFIG_RECEIVER_LOW_POWER
+		return stop_listening() ? EXEC_ERROR : EXEC_RETRY;
+#else
+		static u8 sign = SIGN_1 | SIGN_3 | SIGN_5 | SIGN_7;
 		show_sign(sign);
 		sign ^= 0xFF;
 		return EXEC_RETRY;
+#endif
 	}
 
 	gpio_intr_enable(CONFIG_RMT_RX_GPIO);
 
 	u8 *signals;
 	size_t sigsz;
-	switch (decode_aeha_symbols(data.received_symbols,
-		data.num_symbols, &signals, &sigsz)) {
+	enum decoder_state res;
+
+	hold_power_lock(LOCK_RX_DECODE);
+	if (is_late)
+		res = decode_late_aeha_symbols(data.received_symbols,
+					       data.num_symbols,
+					       &signals, &sigsz);
+	else
+		res = decode_aeha_symbols(data.received_symbols,
+					  data.num_symbols, &signals, &sigsz);
+	release_power_lock(LOCK_RX_DECODE);
+
+	is_late = 0;
+
+	switch (res) {
 	case DEC_SKIP:
 		reset_frame_interval();
 		return EXEC_RETRY;
@@ -0,0 +1,54 @@
+/****************************************************************************
+**
+** Copyright 2024 Jiamu Sun
+** Contact: barroit@linux.com
+**
+** This file is part of livaut.
+**
+** livaut is free software: you can redistribute it and/or modify it
+** under the terms of the GNU General Public License as published by the
+** Free Software Foundation, either version 3 of the License, or (at your
+** option) any later version.
+**
+** livaut is distributed in the hope that it will be useful, but
+** WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+** General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License along
+** with livaut. If not, see <https://www.gnu.org/licenses/>.
+**
+****************************************************************************/
+
+#include "execute-action.h"
+#include "punctuality.h"
+
+/*
+ * prints the punctuality of the scheduler once, and writes what is only in
+ * rtc memory to nvs
+ */
+
+static int is_reported;
+
+int report_punctuality_setup(void)
+{
+	is_reported = 0;
+	return 0;
+}
+
+int report_punctuality_teardown(void)
+{
+	return 0;
+}
+
+enum action_result report_punctuality(void)
+{
+	if (is_reported)
+		return EXEC_AGAIN;
+
+	flush_punctuality();
+	print_punctuality();
+	is_reported = 1;
+
+	return EXEC_AGAIN;
+}
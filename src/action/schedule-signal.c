@@ -21,10 +21,10 @@
 ****************************************************************************/
 
 #include "execute-action.h"
-#include "aeha-protocol.h"
-#include "rmt.h"
+#include "transmit.h"
+#include "schedule.h"
+#include "punctuality.h"
 #include "termio.h"
-#include "signal-schedule.h"
 #include "sntp.h"
 #include "list.h"
 #include "freertos/FreeRTOS.h"
@@ -33,156 +33,219 @@
 #include "power.h"
 #include "memory.h"
 #include "esp_attr.h"
+#include "esp_rom_crc.h"
+#include <stddef.h>
 
 #define TAG "signal_schedule"
 
-#define TRANSFER_QUEUE_DEPTH 4
+/* a schedule is still sent this many seconds after its start */
+#define SCHEDULE_TOLERANCE 5
 
-static rmt_channel_handle_t tx_channel;
-static rmt_encoder_handle_t encoder;
+#define SCHEDULE_IDLE_SLEEP (7 * 86400)
 
-/*
- * these need to be kept during deep sleep
- */
-static RTC_DATA_ATTR u8 next_schedule;
-static RTC_DATA_ATTR int is_today_finished;
+static RTC_DATA_ATTR struct scheduler_state state;
 
-static rmt_tx_channel_config_t get_chan_conf(void)
+static u32 get_state_crc(void)
 {
-	rmt_tx_channel_config_t conf = {
-		.clk_src           = RMT_CLOCK_SOURCE,
-		.gpio_num          = CONFIG_RMT_TX_GPIO,
-		.mem_block_symbols = RMT_MEMORY_BLOCK_SIZE,
-		.resolution_hz     = RMT_CLOCK_RESOLUTION,
-		.trans_queue_depth = TRANSFER_QUEUE_DEPTH,
-	};
+	return esp_rom_crc32_le(0, (const u8 *)&state,
+				offsetof(struct scheduler_state, crc));
+}
 
-	return conf;
+/* the state is for the image in flash, whatever day it was seeked on */
+static int is_state_intact(void)
+{
+	return state.version == SCHEDULER_STATE_VERSION &&
+	       state.crc == get_state_crc() &&
+	       state.sequence == get_schedule_sequence() &&
+	       state.image_crc == get_schedule_crc();
 }
 
-static rmt_carrier_config_t get_carr_conf(void)
+static int is_state_valid(u32 day)
 {
-	FIELD_TYPEOF(rmt_carrier_config_t, flags) flag = {
-		.polarity_active_low = false,
-	};
+	return is_state_intact() && state.day == day;
+}
 
-	rmt_carrier_config_t conf = {
-		.duty_cycle   = AEHA_DUTY_CYCLE,
-		.frequency_hz = AEHA_FREQUENCY,
-		.flags        = flag,
-	};
+static void save_state(void)
+{
+	state.crc = get_state_crc();
+}
 
-	return conf;
+/* due is the first time at or after sec of today */
+static void seek_schedule(u32 day, u32 sec)
+{
+	state.version   = SCHEDULER_STATE_VERSION;
+	state.day       = day;
+	state.due       = find_schedule(sec, get_weekday(), &state.ahead);
+	state.sequence  = get_schedule_sequence();
+	state.image_crc = get_schedule_crc();
+	save_state();
 }
 
 int schedule_signal_setup(void)
 {
-	int err;
-
-	rmt_tx_channel_config_t chan_conf = get_chan_conf();
-	err = CE(rmt_new_tx_channel(&chan_conf, &tx_channel));
-	if (err)
-		return 1;
+	return setup_transmitter();
+}
 
-	rmt_carrier_config_t carr_conf = get_carr_conf();
-	err = CE(rmt_apply_carrier(tx_channel, &carr_conf));
-	if (err)
-		return 1;
+int schedule_signal_teardown(void)
+{
+	int err;
 
-	err = CE(rmt_enable(tx_channel));
+	err = teardown_transmitter();
 	if (err)
 		return 1;
 
-	err = CE(make_aeha_encoder(&encoder));
-	if (err)
-		return 1;
+	state.version = 0;
+	flush_punctuality();
 
 	return 0;
 }
 
-int schedule_signal_teardown(void)
+static int is_schedule_signallable(void)
 {
-	int err;
+	static size_t count;
 
-	err = CE(rmt_disable(tx_channel));
-	if (err)
-		return 1;
+	if (!is_clock_valid()) {
+		if (count++ % 5 == 0)
+			warning(TAG, "system time is not synchronized");
+		return 0;
+	}
 
-	err = CE(rmt_del_channel(tx_channel));
-	if (err)
-		return 1;
+	count = 0;
+	return 1;
+}
 
-	err = CE(encoder->del(encoder));
-	if (err)
-		return 1;
+static inline int should_deep_sleep(u64 seconds)
+{
+	return seconds >= CONFIG_SCHEDULER_SUSPEND_DELAY;
+}
 
-	next_schedule = 0;
+_Static_assert(CONFIG_SCHEDULER_SYNC_LEAD >
+	       CONFIG_WIFI_JOIN_TIMEOUT + CONFIG_SNTP_SYNC_TIMEOUT,
+	       "a sync wake-up would miss the schedule it was for");
 
-	return 0;
+/* seconds from a timer wake-up to being ready to send */
+static u64 get_wake_lead(u64 seconds)
+{
+	return is_clock_trusted_after(seconds) ? CONFIG_SCHEDULER_WAKE_LEAD :
+						 CONFIG_SCHEDULER_SYNC_LEAD;
 }
 
-/* used by test-signal */ int transmit_signal(frame_info_t *frame)
+/*
+ * off-days in between are slept through in one go, the steps of it do not
+ * boot the app
+ */
+static void handle_suspend(u64 seconds)
 {
-	int err = 0;
-	rmt_transmit_config_t conf = { 0 };
+	seconds -= get_wake_lead(seconds);
 
-	if (frame->bnum && !is_lldat_converted(frame->lldat))
-		err = convert_aeha_lldat(frame->lldat, frame->bnum);
+	start_long_sleep(seconds);
+}
 
-	if (err)
-		die(TAG, "invalid lldat found");
+/*
+ * light sleeps up to second at of today, only a jumper change ends it
+ * early, for the executor to look at
+ */
+static void wait_until_due(u64 at)
+{
+	u64 due = at * 1000;
+	u64 ms = get_ms_of_day();
+	u64 last;
 
-	err = rmt_transmit(tx_channel, encoder, frame, ~0, &conf);
-	if (err)
-		return 1;
+	while (ms < due) {
+		if (start_light_sleep(due - ms))
+			return;
 
-	return 0;
+		last = ms;
+		ms = get_ms_of_day();
+
+		/* past midnight, due is counted from the new day */
+		if (ms < last)
+			due = due > 86400000 ? due - 86400000 : 0;
+	}
 }
 
-static int is_schedule_signallable(void)
+static void print_next_schedule(void)
 {
-	static size_t count;
+	u64 ts = state.due;
 
-	if (!is_sntp_started()) {
-		if (count++ % 5 == 0)
-			warning(TAG, "sntp service is not running");
-		return 0;
+	if (state.due == SCHEDULE_NONE) {
+		info(TAG, "no schedule on any day");
+		return;
 	}
 
-	count = 0;
-	return 1;
+	info(TAG, "next schedule is set to run in %u day(s) at " HH_MM_SS,
+	     state.ahead,
+	     sec_to_hour_d(ts), sec_to_min_d(ts), sec_to_sec_d(ts));
 }
 
-static void update_next_schedule(void)
+/* days from day stamp a to b, stamps are tm_year * 366 + tm_yday */
+static u32 get_days_between(u32 a, u32 b)
 {
-	if (next_schedule + 1 == sizeof_array(schedules)) {
-		next_schedule = 0;
-		is_today_finished = 1;
-	} else {
-		next_schedule++;
+	u32 year = a / 366 + 1900;
+	u32 days = 365 + (year % 4 == 0 && (year % 100 || year % 400 == 0));
+
+	if (b < a)
+		return 0;
+	if (a / 366 == b / 366)
+		return b - a;
+	if (a / 366 + 1 == b / 366)
+		return days - a % 366 + b % 366;
+
+	return UINT32_MAX;
+}
+
+/* schedules due from state.due up to sec of today, a week back at most */
+static u32 count_skips(u32 day, u32 sec)
+{
+	u32 from = state.due;
+	u32 gap = get_days_between(state.day, day);
+	u8 wday = get_weekday();
+	u32 i, d, n = 0;
+
+	if (state.due == SCHEDULE_NONE || gap < state.ahead)
+		return 0;
+
+	/* days from the one state.due is on */
+	gap -= state.ahead;
+	if (gap >= WHEEL_DAYS) {
+		gap = WHEEL_DAYS;
+		from = 0;
+	}
+
+	for_each_idx(i, gap + 1) {
+		d = gap - i;
+		n += count_due_schedules(i ? 0 : from, d ? 86400 : sec,
+					 (wday + WHEEL_DAYS - d % WHEEL_DAYS) %
+					 WHEEL_DAYS);
 	}
+
+	return n;
 }
 
-static inline int should_deep_sleep(u64 seconds)
+static void skip_schedules(u32 day, u32 sec)
 {
-	return seconds >= CONFIG_SCHEDULER_SUSPEND_DELAY;
+	u32 n = count_skips(day, sec);
+	u64 ts = state.due;
+
+	if (!n)
+		return;
+
+	record_skip(n);
+	info(TAG, "skipped %" PRIu32 " schedule(s) from " HH_MM_SS, n,
+	     sec_to_hour_d(ts), sec_to_min_d(ts), sec_to_sec_d(ts));
 }
 
-static inline u64 get_suspend_limit(void)
+static inline u32 get_due_second(u64 now)
 {
-	return st_mult(CONFIG_SCHEDULER_SUSPEND_LIMIT, 60);
+	return now > SCHEDULE_TOLERANCE ? now - SCHEDULE_TOLERANCE : 0;
 }
 
-static void handle_suspend(u64 seconds)
+/* ms since second ts of today */
+static u32 get_lateness(u32 ts)
 {
-	u64 limit = get_suspend_limit();
-	if (seconds > limit)
-		seconds = limit;
-	else
-		seconds -= CONFIG_SCHEDULER_SUSPEND_DELAY / 2;
+	u32 ms = get_ms_of_day();
 
-	setup_timer_wakeup(seconds);
-	start_deep_sleep();
+	return ms > ts * 1000 ? ms - ts * 1000 : 0;
 }
 
 enum action_result schedule_signal(void)
@@ -190,48 +253,75 @@ enum action_result schedule_signal(void)
 	if (!is_schedule_signallable())
 		return EXEC_AGAIN;
 
-	const struct signal_schedule *schedule = &schedules[next_schedule];
-	u64 ts = schedule->start, now = get_seconds_of_day();
-	u8 day = get_day_of_week();
-
-	if (!(day & ondays)) {
-		u64 limit = get_suspend_limit();
-		handle_suspend(limit);
-	} else if (now < schedule->start) {
-		if (is_today_finished)
-			is_today_finished = 0;
+	u64 now = get_seconds_of_day();
+	u32 day = get_day_stamp();
 
-		u64 time = schedule->start - now;
+	if (!is_state_valid(day)) {
+		/* a due time left from an earlier day may have gone by */
+		if (is_state_intact())
+			skip_schedules(day, get_due_second(now));
 
-		if (should_deep_sleep(time))
-			handle_suspend(time);
+		seek_schedule(day, get_due_second(now));
+		print_next_schedule();
+	}
 
+	/* nothing is ever due, look again in a week */
+	if (state.due == SCHEDULE_NONE) {
+		handle_suspend(SCHEDULE_IDLE_SLEEP);
 		return EXEC_AGAIN;
-	} else if (is_today_finished) {
-		handle_suspend(st_mult(CONFIG_SCHEDULER_SUSPEND_LIMIT, 60));
-		return EXEC_AGAIN;
-	} else if (now > schedule->start + 5) {
-		update_next_schedule();
+	}
+
+	u64 ts = state.due;
 
-		info(TAG, "skipped a schedule set for " HH_MM_SS,
-		     sec_to_hour_d(ts), sec_to_min_d(ts), sec_to_sec_d(ts));
+	/* seconds from the start of today */
+	u64 at = (u64)state.ahead * 86400 + ts;
 
+	if (now < at) {
+		u64 time = at - now;
+
+		if (should_deep_sleep(time))
+			handle_suspend(time);
+
+		/* no polling on the final approach, it is sent on waking */
+		wait_until_due(at);
+		return EXEC_RETRY;
+	} else if (now > at + SCHEDULE_TOLERANCE) {
+		skip_schedules(day, get_due_second(now));
+		seek_schedule(day, get_due_second(now));
 		return EXEC_RETRY;
 	}
 
-	size_t i;
+	const struct signal_schedule *due[SCHEDULE_DUE_MAX];
+	size_t i, j, n = get_due_schedules(ts, get_weekday(), due);
+	u8 wday = get_day_of_week();
 	int err;
-	for_each_idx(i, schedule->fnum) {
-		err = transmit_signal(&schedule->frame[i]);
-		if (err)
-			return EXEC_ERROR;
+
+	for_each_idx(i, n) {
+		int sent = 0;
+
+		for_each_idx(j, due[i]->fnum) {
+			const struct frame_info *frame = get_frame(due[i], j);
+
+			/* frames of tracks that are off today */
+			if (!(frame->days & wday))
+				continue;
+
+			/* an entry is as late as its first frame */
+			if (!sent++)
+				record_lateness(get_lateness(ts));
+
+			err = transmit_signal(frame);
+			if (err)
+				return EXEC_ERROR;
+		}
 	}
 
-	update_next_schedule();
+	err = wait_transmit_done();
+	if (err)
+		return EXEC_ERROR;
 
-	ts = schedules[next_schedule].start;
-	info(TAG, "next schedule is set to run at " HH_MM_SS,
-	     sec_to_hour_d(ts), sec_to_min_d(ts), sec_to_sec_d(ts));
+	seek_schedule(day, ts + 1);
+	print_next_schedule();
 
 	return EXEC_AGAIN;
 }
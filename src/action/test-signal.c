@@ -0,0 +1,105 @@
+/****************************************************************************
+**
+** Copyright 2024 Jiamu Sun
+** Contact: barroit@linux.com
+**
+** This file is part of livaut.
+**
+** livaut is free software: you can redistribute it and/or modify it
+** under the terms of the GNU General Public License as published by the
+** Free Software Foundation, either version 3 of the License, or (at your
+** option) any later version.
+**
+** livaut is distributed in the hope that it will be useful, but
+** WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+** General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License along
+** with livaut. If not, see <https://www.gnu.org/licenses/>.
+**
+****************************************************************************/
+
+#include "execute-action.h"
+#include "transmit.h"
+#include "schedule.h"
+#include "termio.h"
+#include "list.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+
+#define TAG "test_signal"
+
+static const struct signal_schedule *schedule;
+static size_t sent;
+static u64 start_time;
+static TickType_t last_wake;
+
+int test_signal_setup(void)
+{
+	if (CONFIG_TEST_SIGNAL_SCHEDULE >= get_schedule_num())
+		return error(TAG, "no schedule at index %d",
+			     CONFIG_TEST_SIGNAL_SCHEDULE);
+
+	schedule = get_schedule(CONFIG_TEST_SIGNAL_SCHEDULE);
+	sent = 0;
+
+	return setup_transmitter();
+}
+
+int test_signal_teardown(void)
+{
+	return teardown_transmitter();
+}
+
+static void report_throughput(void)
+{
+	struct transmit_stats st;
+	u64 elapsed = esp_timer_get_time() - start_time;
+
+	get_transmit_stats(&st);
+
+	info(TAG, "sent %" PRIu32 " frames in %" PRIu64 "ms, %.2f frames/s",
+	     st.done, elapsed / 1000, st.done * 1000000.0 / elapsed);
+	info(TAG, "tx queue stalled %" PRIu32 " times", st.stalls);
+
+	if (st.done)
+		info(TAG, "transmit latency avg %" PRIu64 "µs, max %" PRIu64 "µs",
+		     st.latency_sum / st.done, st.latency_max);
+}
+
+enum action_result test_signal(void)
+{
+	size_t i;
+	int err;
+
+	if (!sent) {
+		reset_transmit_stats();
+		start_time = esp_timer_get_time();
+		last_wake = xTaskGetTickCount();
+	}
+
+	for_each_idx(i, schedule->fnum) {
+		err = transmit_signal(get_frame(schedule, i));
+		if (err)
+			return EXEC_ERROR;
+	}
+
+	/* zero interval sends as fast as the tx queue accepts */
+	if (++sent < CONFIG_TEST_SIGNAL_COUNT) {
+		if (CONFIG_TEST_SIGNAL_INTERVAL)
+			xTaskDelayUntil(&last_wake,
+					pdMS_TO_TICKS(CONFIG_TEST_SIGNAL_INTERVAL));
+		return EXEC_RETRY;
+	}
+
+	err = wait_transmit_done();
+	if (err)
+		return EXEC_ERROR;
+
+	report_throughput();
+	sent = 0;
+
+	return EXEC_DONE;
+}
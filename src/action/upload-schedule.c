@@ -0,0 +1,140 @@
+/****************************************************************************
+**
+** Copyright 2024 Jiamu Sun
+** Contact: barroit@linux.com
+**
+** This file is part of livaut.
+**
+** livaut is free software: you can redistribute it and/or modify it
+** under the terms of the GNU General Public License as published by the
+** Free Software Foundation, either version 3 of the License, or (at your
+** option) any later version.
+**
+** livaut is distributed in the hope that it will be useful, but
+** WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+** General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License along
+** with livaut. If not, see <https://www.gnu.org/licenses/>.
+**
+****************************************************************************/
+
+#include "execute-action.h"
+#include "schedule.h"
+#include "termio.h"
+#include "power-lock.h"
+#include "driver/uart.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#define TAG "upload_schedule"
+
+/*
+ * the image comes in on the console uart, see host/upload-schedule.py
+ *
+ * host keeps sending the header until we answer ‘received’, then waits
+ * without sending for ‘accepted’, after the spare slot is erased, or
+ * ‘rejected’, then the host sends the rest and we answer ‘done’ or ‘failed’
+ *
+ * the erase can take longer than the host resends the header, answering
+ * before it keeps the copies down to the ones already on the wire
+ */
+#define UPLOAD_UART     CONFIG_ESP_CONSOLE_UART_NUM
+#define UPLOAD_BUF_SIZE 2048
+#define UPLOAD_CHUNK    256
+#define UPLOAD_TIMEOUT  pdMS_TO_TICKS(2000)
+
+int upload_schedule_setup(void)
+{
+	int err;
+
+	err = CE(uart_driver_install(UPLOAD_UART, UPLOAD_BUF_SIZE, 0,
+				     0, NULL, 0));
+	if (err)
+		return 1;
+
+	/* the uart is not a wake-up source, stay awake for the whole upload */
+	hold_power_lock(LOCK_CONSOLE_RX);
+
+	info(TAG, "ready, running schedule %" PRIu32,
+	     get_schedule_sequence());
+
+	return 0;
+}
+
+int upload_schedule_teardown(void)
+{
+	int err;
+
+	release_power_lock(LOCK_CONSOLE_RX);
+
+	err = CE(uart_driver_delete(UPLOAD_UART));
+	if (err)
+		return 1;
+
+	return 0;
+}
+
+static int receive_image(const struct schedule_header *head)
+{
+	u8 buf[UPLOAD_CHUNK];
+	size_t rest = head->size - sizeof(*head);
+	int n;
+
+	while (rest) {
+		n = uart_read_bytes(UPLOAD_UART, buf,
+				    rest < sizeof(buf) ? rest : sizeof(buf),
+				    UPLOAD_TIMEOUT);
+		if (n <= 0)
+			return error(TAG, "timed out, %zu bytes missing",
+				     rest);
+
+		if (write_schedule_upload(buf, n))
+			return 1;
+
+		rest -= n;
+	}
+
+	return end_schedule_upload();
+}
+
+enum action_result upload_schedule(void)
+{
+	struct schedule_header head;
+	int n, err;
+
+	n = uart_read_bytes(UPLOAD_UART, &head, sizeof(head),
+			    pdMS_TO_TICKS(1000));
+	if (n <= 0)
+		return EXEC_AGAIN;
+
+	/* a partial header, the host will send it again */
+	if (n != sizeof(head)) {
+		uart_flush_input(UPLOAD_UART);
+		return EXEC_AGAIN;
+	}
+
+	info(TAG, "received, %" PRIu32 " bytes", head.size);
+
+	/* drop the copies of the header sent before the host heard us */
+	err = begin_schedule_upload(&head);
+	uart_flush_input(UPLOAD_UART);
+
+	if (err) {
+		info(TAG, "rejected");
+		return EXEC_AGAIN;
+	}
+
+	info(TAG, "accepted");
+
+	if (receive_image(&head)) {
+		uart_flush_input(UPLOAD_UART);
+		info(TAG, "failed");
+		return EXEC_AGAIN;
+	}
+
+	info(TAG, "done, running schedule %" PRIu32, get_schedule_sequence());
+
+	return EXEC_DONE;
+}
@@ -24,9 +24,7 @@
 #define AEHA_PROTOCOL_H
 
 #include "driver/rmt_rx.h"
-#include "driver/rmt_tx.h"
 #include "types.h"
-#include "signal-schedule-def.h"
 
 enum decoder_state {
 	DEC_DONE,
@@ -37,15 +35,19 @@ enum decoder_state {
 enum decoder_state decode_aeha_symbols(rmt_symbol_word_t *s, size_t n,
 				       u8 **buf, size_t *sz);
 
+/*
+ * for the first frame after the receiver was armed by its first edge, the
+ * leader is cut short or missing altogether
+ */
+enum decoder_state decode_late_aeha_symbols(rmt_symbol_word_t *s, size_t n,
+					    u8 **buf, size_t *sz);
+
 void make_aeha_receiver_config(rmt_receive_config_t *conf);
 
 #define AEHA_DUTY_CYCLE 0.33
 #define AEHA_FREQUENCY  38000 /* hz */
+#define AEHA_TIME_UNIT  440   /* µs */
 
-int make_aeha_encoder(rmt_encoder_handle_t *encoder);
-
-int convert_aeha_lldat(u32 *space, size_t n);
-
-int is_lldat_converted(u32 *space);
+#define AEHA_T(x) ((x) * AEHA_TIME_UNIT)
 
 #endif /* AEHA_PROTOCOL_H */
@@ -46,6 +46,9 @@
 		a * b;							\
 	})
 
+/* evaluates to 0, or breaks the build if e is true */
+#define build_bug_on_zero(e) ((int)sizeof(struct { int:(-!!(e)); }))
+
 #define gpio_bit_mask(p) (1ULL << (p))
 
 #define sec_to_hour_d(s) (s / 3600)
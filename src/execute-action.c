@@ -30,6 +30,9 @@
 #include "termio.h"
 #include "power.h"
 
+/* an action that asked to be called again is, at the latest, after this */
+#define EXECUTOR_POLL 1500
+
 enum executor_state {
 	EXECUTOR_INIT,
 	EXECUTOR_SETUP,
@@ -41,7 +44,8 @@ struct executor_context {
 	enum executor_state state;
 	const struct action *act;
 	u8 sign;
-	unsigned idles;
+	int idle;
+	int timed_out;
 };
 
 static const struct action *get_active_action(const struct action *act)
@@ -60,6 +64,32 @@ static void run_spinner(u8 *sign)
 	inverse_sign(sign);
 }
 
+/* returns whether it was an event, not the timeout */
+static int await_event(TickType_t ticks)
+{
+	int woken;
+
+	arm_jumper_watch();
+	woken = ulTaskNotifyTake(pdTRUE, ticks);
+	disarm_jumper_watch();
+
+	return woken;
+}
+
+/*
+ * the sign is drawn once, nothing but a jumper change wakes the cpu until
+ * the idle time is over
+ */
+static void await_idle(struct executor_context *ctx)
+{
+	if (!ctx->idle)
+		show_sign(ctx->sign);
+	ctx->idle = 1;
+
+	if (!await_event(pdMS_TO_TICKS(CONFIG_EXECUTOR_IDLE_TIME * 1000)))
+		ctx->timed_out = 1;
+}
+
 static int do_execute_action(const struct action *actions,
 			     struct executor_context *ctx)
 {
@@ -72,10 +102,10 @@ static int do_execute_action(const struct action *actions,
 	case EXECUTOR_INIT:
 		ctx->act = get_active_action(actions);
 		if (!ctx->act) {
-			run_spinner(&ctx->sign);
-			ctx->idles++;
-			break;
+			await_idle(ctx);
+			return 0;
 		}
+		ctx->idle = 0;
 		ctx->state++;
 		/* FALLTHRU */
 	case EXECUTOR_SETUP:
@@ -111,7 +141,7 @@ static int do_execute_action(const struct action *actions,
 	}
 
 prepare_next:
-	vTaskDelay(pdMS_TO_TICKS(1500));
+	await_event(pdMS_TO_TICKS(EXECUTOR_POLL));
 	return 0;
 }
 
@@ -121,11 +151,16 @@ void execute_action(void *actions)
 		.sign = SIGN_1 | SIGN_3 | SIGN_5 | SIGN_7,
 	};
 
+	if (watch_jumper(xTaskGetCurrentTaskHandle()))
+		start_deep_sleep();
+
+	enable_auto_light_sleep();
+
 	while (39) {
 		if (do_execute_action(actions, &ctx))
 			start_deep_sleep();
 
-		if (ctx.idles > CONFIG_EXECUTOR_IDLE_TIME) {
+		if (ctx.timed_out) {
 			setup_external_wakeup();
 			start_deep_sleep();
 		}
@@ -0,0 +1,368 @@
+/****************************************************************************
+**
+** Copyright 2024 Jiamu Sun
+** Contact: barroit@linux.com
+**
+** This file is part of livaut.
+**
+** livaut is free software: you can redistribute it and/or modify it
+** under the terms of the GNU General Public License as published by the
+** Free Software Foundation, either version 3 of the License, or (at your
+** option) any later version.
+**
+** livaut is distributed in the hope that it will be useful, but
+** WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+** General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License along
+** with livaut. If not, see <https://www.gnu.org/licenses/>.
+**
+****************************************************************************/
+
+#include "ir-protocol.h"
+#include "aeha-protocol.h"
+#include "termio.h"
+#include "list.h"
+#include "esp_attr.h"
+
+const struct ir_protocol ir_protocols[IR_PROTOCOL_NUM] = {
+	[IR_AEHA] = {
+		.name       = "aeha",
+		.frequency  = AEHA_FREQUENCY,
+		.duty_cycle = AEHA_DUTY_CYCLE,
+		.leader     = IR_PULSE(AEHA_T(8), AEHA_T(4)),
+		.bit0       = IR_PULSE(AEHA_T(1), AEHA_T(1)),
+		.bit1       = IR_PULSE(AEHA_T(1), AEHA_T(3)),
+		.trailer    = IR_PULSE(AEHA_T(1), 0),
+	},
+	[IR_NEC] = {
+		.name       = "nec",
+		.frequency  = 38000,
+		.duty_cycle = 0.33,
+		.leader     = IR_PULSE(9000, 4500),
+		.bit0       = IR_PULSE(560, 560),
+		.bit1       = IR_PULSE(560, 1690),
+		.trailer    = IR_PULSE(560, 0),
+	},
+	[IR_SONY] = {
+		.name       = "sony",
+		.frequency  = 40000,
+		.duty_cycle = 0.33,
+		.leader     = IR_PULSE(2400, 600),
+		.bit0       = IR_PULSE(600, 600),
+		.bit1       = IR_PULSE(1200, 600),
+		.gap        = IR_DUR(25000),
+		.repeat     = 2,
+		.flags      = IR_BITS_LEADER,
+	},
+};
+
+enum encoder_state {
+	ENCODE_DELAY,
+	ENCODE_LEADER,
+	ENCODE_BITS,
+	ENCODE_CUSTOMER,
+	ENCODE_DATA,
+	ENCODE_TAILER,
+	ENCODE_GAP,
+};
+
+/*
+ * the descriptors live in flash, while the encoder runs in the rmt isr, which
+ * may be called with cache disabled, so we keep the symbols it needs here
+ */
+struct protocol_symbols {
+	rmt_symbol_word_t leader;
+	rmt_symbol_word_t trailer;
+	rmt_symbol_word_t gap;
+	u8 repeat;
+	u8 flags;
+};
+
+struct encoder_context {
+	rmt_encoder_t base;
+	rmt_encoder_t *copy_encoder;
+	rmt_encoder_t *byte_encoder[IR_PROTOCOL_NUM];
+	struct protocol_symbols protocol[IR_PROTOCOL_NUM];
+	enum encoder_state state;
+	u8 repeat;
+};
+
+#define encoder_context_of(c) \
+	__containerof(c, struct encoder_context, base)
+
+#define is_pulse_set(s) ((s).duration0 != 0)
+
+/*
+ * sub-encoders report their own completion, only the completion of the whole
+ * frame is reported to the driver
+ */
+#define do_encode(enc, dat, n)						\
+	({								\
+		rmt_encode_state_t __s = RMT_ENCODING_RESET;		\
+		symlen += (enc)->encode((enc), channel, (dat), (n), &__s);\
+		if (__s & RMT_ENCODING_COMPLETE)			\
+			ctx->state++;					\
+		__s & RMT_ENCODING_MEM_FULL;				\
+	})
+
+/* a delay is at most 255ms, one symbol holds two halves of 32ms */
+#define DELAY_SYMBOL_MAX 4
+#define DELAY_HALF_MAX   32000 /* µs */
+
+static size_t IRAM_ATTR make_delay_symbols(rmt_symbol_word_t *sym, u8 ms)
+{
+	u32 rest = ms * 1000;
+	size_t n = 0;
+
+	while (rest) {
+		u32 d0 = rest > DELAY_HALF_MAX * 2 ? DELAY_HALF_MAX : rest / 2;
+		u32 d1 = rest - d0 > DELAY_HALF_MAX ? DELAY_HALF_MAX : rest - d0;
+
+		sym[n].level0    = 0;
+		sym[n].duration0 = d0;
+		sym[n].level1    = 0;
+		sym[n].duration1 = d1;
+
+		rest -= d0 + d1;
+		n++;
+	}
+
+	return n;
+}
+
+static size_t IRAM_ATTR encode_frame(rmt_encoder_t *container,
+				     rmt_channel_handle_t channel,
+				     const void *rdat, size_t,
+				     rmt_encode_state_t *state)
+{
+	struct encoder_context *ctx = encoder_context_of(container);
+	const struct tx_frame *frame = rdat;
+	const struct protocol_symbols *ps = &ctx->protocol[frame->proto];
+	rmt_encoder_t *cpenc = ctx->copy_encoder;
+	rmt_encoder_t *btenc = ctx->byte_encoder[frame->proto];
+	size_t symlen = 0;
+	int full;
+
+	*state = RMT_ENCODING_RESET;
+
+again:
+	switch (ctx->state) {
+	case ENCODE_DELAY:
+		rmt_symbol_word_t delay[DELAY_SYMBOL_MAX];
+		size_t n = make_delay_symbols(delay, frame->delay);
+
+		if (!frame->delay)
+			ctx->state++;
+		else if (do_encode(cpenc, delay, n * sizeof(*delay)))
+			goto mem_full;
+		/* FALLTHRU */
+	case ENCODE_LEADER:
+		if ((frame->bnum && !(ps->flags & IR_BITS_LEADER)) ||
+		    !is_pulse_set(ps->leader))
+			ctx->state++;
+		else if (do_encode(cpenc, &ps->leader, sizeof(ps->leader)))
+			goto mem_full;
+		/* FALLTHRU */
+	case ENCODE_BITS:
+		if (!frame->bnum) {
+			ctx->state++;
+		} else {
+			full = do_encode(cpenc, frame->bits,
+					 frame->bnum * sizeof(rmt_symbol_word_t));
+			if (ctx->state != ENCODE_BITS)
+				ctx->state = ENCODE_TAILER;
+			if (full)
+				goto mem_full;
+
+			goto again;
+		}
+		/* FALLTHRU */
+	case ENCODE_CUSTOMER:
+		/**
+		 * we just need to manage the state; the copy and byte
+		 * encoder handle data truncation recovery
+		 */
+		if (do_encode(btenc, frame->bytes, frame->cnum))
+			goto mem_full;
+		/* FALLTHRU */
+	case ENCODE_DATA:
+		if (do_encode(btenc, &frame->bytes[frame->cnum], frame->unum))
+			goto mem_full;
+		/* FALLTHRU */
+	case ENCODE_TAILER:
+		if (!is_pulse_set(ps->trailer))
+			ctx->state++;
+		else if (do_encode(cpenc, &ps->trailer, sizeof(ps->trailer)))
+			goto mem_full;
+		/* FALLTHRU */
+	case ENCODE_GAP:
+		if (ctx->repeat == ps->repeat)
+			break;
+
+		full = do_encode(cpenc, &ps->gap, sizeof(ps->gap));
+		if (ctx->state != ENCODE_GAP) {
+			ctx->repeat++;
+			ctx->state = ENCODE_LEADER;
+		}
+		if (full)
+			goto mem_full;
+
+		goto again;
+	}
+
+	ctx->state = ENCODE_DELAY;
+	ctx->repeat = 0;
+	*state |= RMT_ENCODING_COMPLETE;
+	return symlen;
+
+mem_full:
+	*state |= RMT_ENCODING_MEM_FULL;
+	return symlen;
+}
+
+static int free_encoder(rmt_encoder_t *container)
+{
+	struct encoder_context *ctx = encoder_context_of(container);
+	size_t i;
+
+	rmt_del_encoder(ctx->copy_encoder);
+	for_each_idx(i, IR_PROTOCOL_NUM)
+		rmt_del_encoder(ctx->byte_encoder[i]);
+	free(ctx);
+
+	return 0;
+}
+
+static int reset_encoder(rmt_encoder_t *container)
+{
+	struct encoder_context *ctx = encoder_context_of(container);
+	size_t i;
+
+	rmt_encoder_reset(ctx->copy_encoder);
+	for_each_idx(i, IR_PROTOCOL_NUM)
+		rmt_encoder_reset(ctx->byte_encoder[i]);
+	ctx->state = ENCODE_DELAY;
+	ctx->repeat = 0;
+
+	return 0;
+}
+
+static rmt_symbol_word_t make_symbol(const struct ir_pulse *p)
+{
+	rmt_symbol_word_t s = {
+		.level0    = 1,
+		.duration0 = p->mark,
+		.level1    = 0,
+		.duration1 = p->space,
+	};
+
+	return s;
+}
+
+static rmt_symbol_word_t make_gap_symbol(u16 gap)
+{
+	rmt_symbol_word_t s = {
+		.level0    = 0,
+		.duration0 = gap / 2,
+		.level1    = 0,
+		.duration1 = gap - gap / 2,
+	};
+
+	return s;
+}
+
+static void make_protocol_symbols(struct protocol_symbols *ps,
+				  const struct ir_protocol *p)
+{
+	ps->leader  = make_symbol(&p->leader);
+	ps->trailer = make_symbol(&p->trailer);
+	ps->gap     = make_gap_symbol(p->gap);
+	ps->repeat  = p->repeat;
+	ps->flags   = p->flags;
+}
+
+static int make_encoder_context(struct encoder_context **ctx)
+{
+	/* rmt_alloc_encoder_mem uses calloc() */
+	*ctx = rmt_alloc_encoder_mem(sizeof(**ctx));
+	if (!*ctx)
+		return ESP_ERR_NO_MEM;
+
+	struct encoder_context *c = *ctx;
+	size_t i;
+
+	c->base.encode = encode_frame;
+	c->base.del    = free_encoder;
+	c->base.reset  = reset_encoder;
+
+	for_each_idx(i, IR_PROTOCOL_NUM)
+		make_protocol_symbols(&c->protocol[i], get_ir_protocol(i));
+
+	return 0;
+}
+
+static int init_copy_encoder(struct encoder_context *ctx)
+{
+	rmt_copy_encoder_config_t conf; /* fake config */
+	return rmt_new_copy_encoder(&conf, &ctx->copy_encoder);
+}
+
+static int init_byte_encoder(struct encoder_context *ctx,
+			     enum ir_protocol_id id)
+{
+	const struct ir_protocol *p = get_ir_protocol(id);
+	rmt_bytes_encoder_config_t conf = {
+		.bit0 = make_symbol(&p->bit0),
+		.bit1 = make_symbol(&p->bit1),
+		.flags.msb_first = !!(p->flags & IR_MSB_FIRST),
+	};
+
+	return rmt_new_bytes_encoder(&conf, &ctx->byte_encoder[id]);
+}
+
+int make_ir_encoder(rmt_encoder_handle_t *encoder)
+{
+	struct encoder_context *ctx;
+	size_t i;
+
+	int res = make_encoder_context(&ctx);
+	if (res)
+		goto err_make_enc_ctx;
+
+	res = init_copy_encoder(ctx);
+	if (res)
+		goto err_init_cp_enc;
+
+	for_each_idx(i, IR_PROTOCOL_NUM) {
+		res = init_byte_encoder(ctx, i);
+		if (res)
+			goto err_init_bt_enc;
+	}
+
+	*encoder = &ctx->base;
+	return 0;
+
+err_init_bt_enc:
+	while (i--)
+		rmt_del_encoder(ctx->byte_encoder[i]);
+	rmt_del_encoder(ctx->copy_encoder);
+err_init_cp_enc:
+	free(ctx);
+err_make_enc_ctx:
+	return res;
+}
+
+void make_bit_symbols(rmt_symbol_word_t *sym,
+		      const u8 *bits, size_t n, enum ir_protocol_id id)
+{
+	const struct ir_protocol *p = get_ir_protocol(id);
+	size_t i;
+
+	for_each_idx(i, n) {
+		u8 bit = bits[i / 8] >> (i % 8) & 1;
+
+		sym[i] = make_symbol(bit ? &p->bit1 : &p->bit0);
+	}
+}
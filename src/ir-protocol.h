@@ -0,0 +1,100 @@
+/****************************************************************************
+**
+** Copyright 2024 Jiamu Sun
+** Contact: barroit@linux.com
+**
+** This file is part of livaut.
+**
+** livaut is free software: you can redistribute it and/or modify it
+** under the terms of the GNU General Public License as published by the
+** Free Software Foundation, either version 3 of the License, or (at your
+** option) any later version.
+**
+** livaut is distributed in the hope that it will be useful, but
+** WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+** General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License along
+** with livaut. If not, see <https://www.gnu.org/licenses/>.
+**
+****************************************************************************/
+
+#ifndef IR_PROTOCOL_H
+#define IR_PROTOCOL_H
+
+#include "driver/rmt_tx.h"
+#include "signal-schedule-def.h"
+#include "types.h"
+#include "calc.h"
+
+/* stored in schedule images, append only */
+enum ir_protocol_id {
+	IR_AEHA,
+	IR_NEC,
+	IR_SONY,
+	IR_PROTOCOL_NUM,
+};
+
+/* durations are in µs, a zero mark means the pulse is not sent */
+struct ir_pulse {
+	u16 mark;
+	u16 space;
+};
+
+/*
+ * bit-level frames are sent as is, unless the protocol has IR_BITS_LEADER,
+ * then the leader goes before them
+ */
+#define IR_MSB_FIRST   (1 << 0)
+#define IR_BITS_LEADER (1 << 1)
+
+struct ir_protocol {
+	const char *name;
+	u32 frequency; /* hz */
+	float duty_cycle;
+	struct ir_pulse leader;
+	struct ir_pulse bit0;
+	struct ir_pulse bit1;
+	struct ir_pulse trailer;
+	u16 gap;   /* µs, silence between repeats */
+	u8 repeat; /* times the frame is sent again */
+	u8 flags;
+};
+
+/* a symbol duration is 15 bits, at RMT_CLOCK_RESOLUTION (1 tick is 1µs) */
+#define IR_MAX_DURATION 32767
+
+#define IR_DUR(us) ((us) + build_bug_on_zero((us) > IR_MAX_DURATION))
+
+#define IR_PULSE(m, s)				\
+	{					\
+		.mark  = IR_DUR(m),		\
+		.space = IR_DUR(s),		\
+	}
+
+extern const struct ir_protocol ir_protocols[IR_PROTOCOL_NUM];
+
+#define get_ir_protocol(id) (&ir_protocols[id])
+
+/*
+ * what the encoder sends, frame_info_t unpacked into ram, the rmt isr may
+ * run with cache disabled and cannot read the schedule in flash
+ */
+struct tx_frame {
+	rmt_symbol_word_t bits[FRAME_BITS_MAX];
+	u8 bytes[FRAME_BYTES_MAX]; /* customer code, then data */
+	u8 cnum;
+	u8 unum;
+	u8 bnum;
+	u8 delay;
+	u8 proto;
+};
+
+int make_ir_encoder(rmt_encoder_handle_t *encoder);
+
+/* bits holds n bits, lsb first */
+void make_bit_symbols(rmt_symbol_word_t *sym,
+		      const u8 *bits, size_t n, enum ir_protocol_id id);
+
+#endif /* IR_PROTOCOL_H */
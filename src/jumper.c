@@ -30,6 +30,9 @@
 #include "calc.h"
 #include "power.h"
 #include "memory.h"
+#include "esp_attr.h"
+#include "esp_sleep.h"
+#include <stdint.h>
 
 #define TAG "jumper"
 
@@ -45,6 +48,8 @@ static const u8 input_jumpers[]  = {
 	CONFIG_JUMPER_INPUT_5
 };
 
+static TaskHandle_t watcher;
+
 static u64 get_pin_bitmap(const u8 *js, size_t n)
 {
 	size_t i;
@@ -165,3 +170,89 @@ int is_jumper_set(u8 j1, u8 j2)
 
 	return is_gpio_connected(j1, j2, 1) && is_gpio_connected(j1, j2, 0);
 }
+
+static void IRAM_ATTR notice_jumper_change(void *pin)
+{
+	BaseType_t unblk = pdFALSE;
+
+	/* a level interrupt keeps firing until it is armed again */
+	gpio_intr_disable((uintptr_t)pin);
+
+	vTaskNotifyGiveFromISR(watcher, &unblk);
+	portYIELD_FROM_ISR(unblk);
+}
+
+int watch_jumper(TaskHandle_t task)
+{
+	int err;
+	size_t i;
+
+	watcher = task;
+
+	/* shared with the rx gpio of receive_signal */
+	err = CE(gpio_install_isr_service(ESP_INTR_FLAG_IRAM));
+	if (err)
+		return 1;
+
+	for_each_idx(i, sizeof_array(input_jumpers)) {
+		u8 j = input_jumpers[i];
+
+		gpio_intr_disable(j);
+		err = CE(gpio_isr_handler_add(j, notice_jumper_change,
+					      (void *)(uintptr_t)j));
+		if (err)
+			return 1;
+	}
+
+	return CE(esp_sleep_enable_gpio_wakeup());
+}
+
+/*
+ * the levels are those is_jumper_set() left behind, with the output
+ * jumper low, so a change is the opposite level
+ */
+void arm_jumper_wakeup(void)
+{
+	size_t i;
+
+	for_each_idx(i, sizeof_array(input_jumpers)) {
+		u8 j = input_jumpers[i];
+		gpio_int_type_t type = gpio_get_level(j) ?
+				       GPIO_INTR_LOW_LEVEL :
+				       GPIO_INTR_HIGH_LEVEL;
+
+		gpio_wakeup_enable(j, type);
+	}
+}
+
+void disarm_jumper_wakeup(void)
+{
+	size_t i;
+
+	for_each_idx(i, sizeof_array(input_jumpers))
+		gpio_wakeup_disable(input_jumpers[i]);
+}
+
+void arm_jumper_watch(void)
+{
+	size_t i;
+
+	arm_jumper_wakeup();
+
+	for_each_idx(i, sizeof_array(input_jumpers))
+		gpio_intr_enable(input_jumpers[i]);
+}
+
+/*
+ * is_jumper_set() toggles the output, which would notify connected ones,
+ * and the wake-up levels are stale once it did
+ */
+void disarm_jumper_watch(void)
+{
+	size_t i;
+
+	for_each_idx(i, sizeof_array(input_jumpers))
+		gpio_intr_disable(input_jumpers[i]);
+
+	disarm_jumper_wakeup();
+}
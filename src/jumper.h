@@ -24,6 +24,8 @@
 #define JUMPER_H
 
 #include "types.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 
 int config_jumper(void);
 
@@ -37,4 +39,19 @@ u64 get_jumper_output_bitmap(void);
 
 u64 get_jumper_input_bitmap(void);
 
+/*
+ * notifies task when an input jumper changes, between arm_jumper_watch()
+ * and disarm_jumper_watch(), a change also ends a light sleep
+ */
+int watch_jumper(TaskHandle_t task);
+
+void arm_jumper_watch(void);
+
+void disarm_jumper_watch(void);
+
+/* only the light sleep wake-ups of the watch, for a task of its own */
+void arm_jumper_wakeup(void);
+
+void disarm_jumper_wakeup(void);
+
 #endif /* JUMPER_H */
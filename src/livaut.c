@@ -32,13 +32,26 @@
 #include "nvs.h"
 #include "sntp.h"
 #include "power.h"
+#include "schedule.h"
+#include "punctuality.h"
+#include "power-lock.h"
+#include "termio.h"
+#include "esp_sleep.h"
+
+#define TAG "livaut"
 
 ACTION_DECLARATION(schedule_signal);
 ACTION_DECLARATION(receive_signal);
+ACTION_DECLARATION(test_signal);
+ACTION_DECLARATION(upload_schedule);
+ACTION_DECLARATION(report_punctuality);
 
 static const struct action actions[] = {
 	ACT(schedule_signal,   GPIO_NUM_32, GPIO_NUM_26),
 	ACT(receive_signal, GPIO_NUM_32, GPIO_NUM_25),
+	ACT(test_signal,    GPIO_NUM_32, GPIO_NUM_27),
+	ACT(upload_schedule, GPIO_NUM_32, GPIO_NUM_14),
+	ACT(report_punctuality, GPIO_NUM_32, GPIO_NUM_12),
 	ACT_END(),
 };
 
@@ -48,7 +61,14 @@ void at_sta2ap_connect(int err)
 		release_nvs_flash();
 	} else {
 		config_sntp_service();
-		start_sntp_service();
+
+		/* the cached address may have been leased to another host */
+		if (start_sntp_service())
+			forget_sta2ap_cache();
+
+		/* the time is all the network is needed for */
+		stop_sntp_service();
+		disconnect_sta2ap();
 	}
 }
 
@@ -56,12 +76,25 @@ void app_main(void)
 {
 	int err;
 
+	resume_long_sleep();
+
+	collaborate_timezone();
+	correct_clock_drift();
+
+	/*
+	 * the rtc kept the time through deep sleep, as long as it is good
+	 * enough the due schedule goes out without wifi, sntp or nvs
+	 */
+	if (esp_sleep_get_wakeup_cause() == ESP_SLEEP_WAKEUP_TIMER &&
+	    is_clock_trusted()) {
+		info(TAG, "warm wake-up, trusting the rtc clock");
+		goto setup_jumper;
+	}
+
 	err = init_nvs_flash();
 	if (err)
 		goto setup_jumper;
 
-	collaborate_timezone();
-
 	xTaskCreate(make_sta2ap_connection, "wifi_setup", 4096,
 		    at_sta2ap_connect, 5, NULL);
 
@@ -82,6 +115,17 @@ setup_jumper:
 		uninstall_master_bus();
 
 do_action:
+	err = init_power_lock();
+	if (err)
+		warning(TAG, "no power locks, decoding may run slowed down");
+
+	load_schedule();
+	load_punctuality();
+
+	/* not on each scheduled wake-up, the console is slow */
+	if (esp_sleep_get_wakeup_cause() != ESP_SLEEP_WAKEUP_TIMER)
+		print_punctuality();
+
 	xTaskCreate(execute_action, "action_exec", 4096,
 		    (void *)actions, 15, NULL);
 }
@@ -26,6 +26,8 @@
 
 #define TAG "nvs_flash"
 
+static int is_initialized;
+
 int init_nvs_flash(void)
 {
 	int err;
@@ -44,6 +46,7 @@ int init_nvs_flash(void)
 	if (err)
 		return 1;
 
+	is_initialized = 1;
 	info(TAG, "initialized");
 
 	return 0;
@@ -52,6 +55,12 @@ int init_nvs_flash(void)
 void release_nvs_flash(void)
 {
 	CE(nvs_flash_deinit());
+	is_initialized = 0;
 
 	info(TAG, "released");
 }
+
+int is_nvs_ready(void)
+{
+	return is_initialized;
+}
@@ -27,4 +27,7 @@ int init_nvs_flash(void);
 
 void release_nvs_flash(void);
 
+/* not on warm wake-ups, nor once wifi gave up */
+int is_nvs_ready(void);
+
 #endif /* NVS_H */
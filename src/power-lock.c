@@ -0,0 +1,120 @@
+/****************************************************************************
+**
+** Copyright 2024 Jiamu Sun
+** Contact: barroit@linux.com
+**
+** This file is part of livaut.
+**
+** livaut is free software: you can redistribute it and/or modify it
+** under the terms of the GNU General Public License as published by the
+** Free Software Foundation, either version 3 of the License, or (at your
+** option) any later version.
+**
+** livaut is distributed in the hope that it will be useful, but
+** WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+** General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License along
+** with livaut. If not, see <https://www.gnu.org/licenses/>.
+**
+****************************************************************************/
+
+#include "power-lock.h"
+#include "termio.h"
+#include "list.h"
+#include "memory.h"
+#include "esp_attr.h"
+#include "esp_pm.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+
+#define TAG "power_lock"
+
+struct power_lock {
+	const char *name;
+	esp_pm_lock_type_t type;
+	esp_pm_lock_handle_t handle;
+	u32 depth;
+	u64 since;
+	struct power_lock_stats stats;
+};
+
+static struct power_lock locks[LOCK_ID_MAX] = {
+	[LOCK_RX_CAPTURE] = { "rx_capture", ESP_PM_APB_FREQ_MAX },
+	[LOCK_RX_DECODE]  = { "rx_decode",  ESP_PM_CPU_FREQ_MAX },
+	[LOCK_TX_BURST]   = { "tx_burst",   ESP_PM_CPU_FREQ_MAX },
+	[LOCK_CONSOLE_RX] = { "console_rx", ESP_PM_NO_LIGHT_SLEEP },
+};
+
+static portMUX_TYPE locks_mux = portMUX_INITIALIZER_UNLOCKED;
+
+int init_power_lock(void)
+{
+	size_t i;
+	int err;
+
+	for_each_idx(i, sizeof_array(locks)) {
+		struct power_lock *l = &locks[i];
+
+		/* without CONFIG_PM_ENABLE the clocks never change */
+		err = esp_pm_lock_create(l->type, 0, l->name, &l->handle);
+		if (err == ESP_ERR_NOT_SUPPORTED)
+			continue;
+		if (CE(err))
+			return 1;
+	}
+
+	return 0;
+}
+
+/* esp_pm locks count themselves, the depth is kept for the stats only */
+void IRAM_ATTR hold_power_lock(enum power_lock_id id)
+{
+	struct power_lock *l = &locks[id];
+
+	if (l->handle)
+		esp_pm_lock_acquire(l->handle);
+
+	portENTER_CRITICAL_SAFE(&locks_mux);
+	if (!l->depth++) {
+		l->since = esp_timer_get_time();
+		l->stats.taken++;
+	}
+	portEXIT_CRITICAL_SAFE(&locks_mux);
+}
+
+void IRAM_ATTR release_power_lock(enum power_lock_id id)
+{
+	struct power_lock *l = &locks[id];
+
+	portENTER_CRITICAL_SAFE(&locks_mux);
+	if (l->depth && !--l->depth)
+		l->stats.held += esp_timer_get_time() - l->since;
+	portEXIT_CRITICAL_SAFE(&locks_mux);
+
+	if (l->handle)
+		esp_pm_lock_release(l->handle);
+}
+
+void get_power_lock_stats(enum power_lock_id id, struct power_lock_stats *st)
+{
+	portENTER_CRITICAL(&locks_mux);
+	*st = locks[id].stats;
+	portEXIT_CRITICAL(&locks_mux);
+}
+
+void print_power_lock(void)
+{
+	size_t i;
+	struct power_lock_stats st;
+
+	for_each_idx(i, sizeof_array(locks)) {
+		get_power_lock_stats(i, &st);
+		if (!st.taken)
+			continue;
+
+		info(TAG, "%s held %" PRIu32 " times for %" PRIu64 "ms",
+		     locks[i].name, st.taken, st.held / 1000);
+	}
+}
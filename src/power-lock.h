@@ -0,0 +1,57 @@
+/****************************************************************************
+**
+** Copyright 2024 Jiamu Sun
+** Contact: barroit@linux.com
+**
+** This file is part of livaut.
+**
+** livaut is free software: you can redistribute it and/or modify it
+** under the terms of the GNU General Public License as published by the
+** Free Software Foundation, either version 3 of the License, or (at your
+** option) any later version.
+**
+** livaut is distributed in the hope that it will be useful, but
+** WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+** General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License along
+** with livaut. If not, see <https://www.gnu.org/licenses/>.
+**
+****************************************************************************/
+
+#ifndef POWER_LOCK_H
+#define POWER_LOCK_H
+
+#include "types.h"
+
+/*
+ * the cpu runs at the lowest frequency unless one of these is held, each
+ * is held only across the work that cannot run slower
+ */
+enum power_lock_id {
+	LOCK_RX_CAPTURE, /* rmt sampling, apb must not change */
+	LOCK_RX_DECODE,  /* symbols to bytes, cpu at full speed */
+	LOCK_TX_BURST,   /* encoding and carrier, both of the above */
+	LOCK_CONSOLE_RX, /* uart reads, light sleep drops incoming bytes */
+	LOCK_ID_MAX,
+};
+
+struct power_lock_stats {
+	u32 taken; /* times it went from free to held */
+	u64 held;  /* µs */
+};
+
+int init_power_lock(void);
+
+/* both may be called from an isr, holds nest */
+void hold_power_lock(enum power_lock_id id);
+
+void release_power_lock(enum power_lock_id id);
+
+void get_power_lock_stats(enum power_lock_id id, struct power_lock_stats *st);
+
+/* the ones taken in this boot */
+void print_power_lock(void);
+
+#endif /* POWER_LOCK_H */
@@ -30,6 +30,73 @@
 #include "soc/gpio_num.h"
 #include "wifi.h"
 #include "sign.h"
+#include "sntp.h"
+#include "esp_attr.h"
+#include "esp_rom_crc.h"
+#include "esp_wake_stub.h"
+#include "soc/rtc.h"
+#include "driver/uart.h"
+#include "esp_pm.h"
+#include "power-lock.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <stddef.h>
+
+#define TAG "power"
+
+#define SLEEP_PLAN_VERSION 2
+
+static RTC_DATA_ATTR struct sleep_plan plan;
+
+/* the plan is also read by the wake stub, so these live in rtc memory */
+static RTC_IRAM_ATTR u32 get_plan_crc(void)
+{
+	return esp_rom_crc32_le(0, (const u8 *)&plan,
+				offsetof(struct sleep_plan, crc));
+}
+
+static RTC_IRAM_ATTR int is_plan_pending(void)
+{
+	return plan.version == SLEEP_PLAN_VERSION &&
+	       plan.crc == get_plan_crc() && plan.remaining;
+}
+
+/* µs of the next step */
+static RTC_IRAM_ATTR u64 take_plan_step(void)
+{
+	u64 step = plan.remaining < plan.step ? plan.remaining : plan.step;
+
+	plan.remaining -= step;
+	plan.crc = get_plan_crc();
+
+	return step;
+}
+
+static void save_plan(u64 remaining, u64 step)
+{
+	plan.version   = SLEEP_PLAN_VERSION;
+	plan.remaining = remaining;
+	plan.step      = step;
+	plan.crc       = get_plan_crc();
+}
+
+#ifdef CONFIG_SCHEDULER_WAKE_STUB
+/*
+ * runs on each wake-up before the bootloader, the steps of a long sleep go
+ * back to sleep from here, only rom functions and rtc memory are usable
+ */
+static void RTC_IRAM_ATTR wake_from_step(void)
+{
+	if (!(esp_wake_stub_get_wakeup_cause() & RTC_TIMER_TRIG_EN) ||
+	    !is_plan_pending()) {
+		esp_default_wake_deep_sleep();
+		return;
+	}
+
+	esp_wake_stub_set_wakeup_time(take_plan_step());
+	esp_wake_stub_sleep(&wake_from_step);
+}
+#endif
 
 int verify_wakeup_jumper(const u8 *js, size_t j)
 {
@@ -60,7 +127,7 @@ static void config_output_jumper(const u8 *js, size_t n)
 	}
 }
 
-void setup_external_wakeup(void)
+static void config_wakeup_jumper(void)
 {
 	size_t n;
 	const u8 *jumpers;
@@ -70,14 +137,26 @@ void setup_external_wakeup(void)
 
 	n = get_input_jumper(&jumpers);
 	config_input_jumper(jumpers, n);
+}
+
+void setup_external_wakeup(void)
+{
+	config_wakeup_jumper();
 
 	u64 mask = get_jumper_input_bitmap() | get_jumper_output_bitmap();
 	esp_sleep_enable_ext1_wakeup_io(mask, ESP_EXT1_WAKEUP_ALL_LOW);
 }
 
-void setup_timer_wakeup(u64 seconds)
+/*
+ * a long sleep is taken with the jumper of the scheduler set, which pulls
+ * the output low, the output going high is the jumper being pulled
+ */
+static void setup_jumper_release_wakeup(void)
 {
-	esp_sleep_enable_timer_wakeup(st_mult(seconds, 1000000ULL));
+	config_wakeup_jumper();
+
+	esp_sleep_enable_ext1_wakeup_io(get_jumper_output_bitmap(),
+					ESP_EXT1_WAKEUP_ANY_HIGH);
 }
 
 void start_deep_sleep(void)
@@ -86,5 +165,88 @@ void start_deep_sleep(void)
 	if (is_sta2ap_connected())
 		disconnect_sta2ap();
 
+	info(TAG, "radio was on for %" PRIu64 "ms in this boot",
+	     get_radio_time());
+	print_power_lock();
+
+	mark_sleep_start();
+	esp_deep_sleep_start();
+}
+
+void start_long_sleep(u64 seconds)
+{
+	u64 us = fix_sleep_duration(st_mult(seconds, 1000000ULL));
+	u64 step = st_mult(CONFIG_SCHEDULER_SUSPEND_LIMIT, 60000000ULL);
+
+	save_plan(us, step);
+	esp_sleep_enable_timer_wakeup(take_plan_step());
+	setup_jumper_release_wakeup();
+
+#ifdef CONFIG_SCHEDULER_WAKE_STUB
+	esp_set_deep_sleep_wake_stub(&wake_from_step);
+#endif
+
+	start_deep_sleep();
+}
+
+int enable_auto_light_sleep(void)
+{
+#ifdef CONFIG_EXECUTOR_LIGHT_SLEEP
+	esp_pm_config_t conf = {
+		.max_freq_mhz       = CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ,
+		.min_freq_mhz       = rtc_clk_xtal_freq_get(),
+		.light_sleep_enable = true,
+	};
+
+	return CE(esp_pm_configure(&conf));
+#else
+	return 0;
+#endif
+}
+
+int start_light_sleep(u64 ms)
+{
+	int err, woken;
+
+	/* light sleep would drop the connection */
+	if (is_sta2ap_connected())
+		goto wait_awake;
+
+	/* the console stops too, let the last log line out */
+	uart_wait_tx_idle_polling(CONFIG_ESP_CONSOLE_UART_NUM);
+
+	arm_jumper_wakeup();
+	err = esp_sleep_enable_timer_wakeup(st_mult(ms, 1000ULL)) ||
+	      esp_light_sleep_start();
+	disarm_jumper_wakeup();
+	esp_sleep_disable_wakeup_source(ESP_SLEEP_WAKEUP_TIMER);
+	if (!err)
+		return esp_sleep_get_wakeup_cause() == ESP_SLEEP_WAKEUP_GPIO;
+
+wait_awake:
+	arm_jumper_watch();
+	woken = ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(ms) + 1);
+	disarm_jumper_watch();
+
+	return woken;
+}
+
+void resume_long_sleep(void)
+{
+	if (!is_plan_pending())
+		return;
+
+	/* a jumper, or a power loss, ends the plan */
+	if (esp_sleep_get_wakeup_cause() != ESP_SLEEP_WAKEUP_TIMER) {
+		save_plan(0, 0);
+		return;
+	}
+
+	/*
+	 * the system time goes on counting, correct_clock_drift() takes
+	 * care of the whole sleep at once
+	 */
+	esp_sleep_enable_timer_wakeup(take_plan_step());
+	setup_jumper_release_wakeup();
 	esp_deep_sleep_start();
 }
@@ -25,12 +25,48 @@
 
 #include "types.h"
 
+/*
+ * kept in rtc memory, the rest of a sleep longer than one step of
+ * CONFIG_SCHEDULER_SUSPEND_LIMIT
+ */
+struct sleep_plan {
+	u32 version;
+	u32 reserved;
+	u64 remaining; /* µs of rtc time */
+	u64 step;      /* µs */
+	u32 crc;       /* of the fields above */
+};
+
 int verify_wakeup_jumper(const u8 *js, size_t j);
 
 void setup_external_wakeup(void);
 
-void setup_timer_wakeup(u64 seconds);
-
 void start_deep_sleep(void);
 
+/*
+ * sleeps seconds of real time, in steps of at most
+ * CONFIG_SCHEDULER_SUSPEND_LIMIT chained by resume_long_sleep(), pulling
+ * the jumper ends it at any step
+ */
+void start_long_sleep(u64 seconds);
+
+/*
+ * lets the cpu light sleep whenever all tasks are blocked, the wake-up
+ * sources are the timers and the gpios enabled for it
+ */
+int enable_auto_light_sleep(void);
+
+/*
+ * light sleeps ms with the timer, or waits awake while wifi is up, returns
+ * whether a jumper change ended it early, the executor alone calls it, its
+ * jumper watch ends the awake wait
+ */
+int start_light_sleep(u64 ms);
+
+/*
+ * the first thing on boot, goes back to sleep if a long sleep is not over,
+ * without touching anything else, unless the wake stub already did
+ */
+void resume_long_sleep(void);
+
 #endif /* POWER_H */
@@ -0,0 +1,192 @@
+/****************************************************************************
+**
+** Copyright 2024 Jiamu Sun
+** Contact: barroit@linux.com
+**
+** This file is part of livaut.
+**
+** livaut is free software: you can redistribute it and/or modify it
+** under the terms of the GNU General Public License as published by the
+** Free Software Foundation, either version 3 of the License, or (at your
+** option) any later version.
+**
+** livaut is distributed in the hope that it will be useful, but
+** WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+** General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License along
+** with livaut. If not, see <https://www.gnu.org/licenses/>.
+**
+****************************************************************************/
+
+#include "punctuality.h"
+#include "nvs.h"
+#include "termio.h"
+#include "list.h"
+#include "memory.h"
+#include "nvs_flash.h"
+#include "esp_attr.h"
+#include "esp_rom_crc.h"
+#include <stddef.h>
+#include <string.h>
+
+#define TAG "punctuality"
+
+#define PUNCTUALITY_VERSION 1
+
+#define PUNCTUALITY_NAMESPACE "punctuality"
+#define PUNCTUALITY_KEY       "histogram"
+
+/* nvs pages wear out, a power loss loses at most this many records */
+#define PUNCTUALITY_FLUSH_EVERY 16
+
+static const u32 bounds[PUNCTUALITY_BUCKETS - 1] = PUNCTUALITY_BOUNDS;
+
+static RTC_DATA_ATTR struct punctuality record;
+
+static u32 get_record_crc(const struct punctuality *p)
+{
+	return esp_rom_crc32_le(0, (const u8 *)p,
+				offsetof(struct punctuality, crc));
+}
+
+static int is_record_valid(const struct punctuality *p)
+{
+	return p->version == PUNCTUALITY_VERSION &&
+	       p->crc == get_record_crc(p);
+}
+
+static void save_record(void)
+{
+	record.crc = get_record_crc(&record);
+}
+
+static int read_nvs_record(struct punctuality *p)
+{
+	nvs_handle_t nvs;
+	size_t size = sizeof(*p);
+	int err;
+
+	err = nvs_open(PUNCTUALITY_NAMESPACE, NVS_READONLY, &nvs);
+	if (err)
+		return 1;
+
+	err = nvs_get_blob(nvs, PUNCTUALITY_KEY, p, &size);
+	nvs_close(nvs);
+
+	return err || size != sizeof(*p) || !is_record_valid(p);
+}
+
+void load_punctuality(void)
+{
+	struct punctuality p;
+
+	if (is_record_valid(&record))
+		return;
+
+	if (read_nvs_record(&p)) {
+		memset(&record, 0, sizeof(record));
+		record.version = PUNCTUALITY_VERSION;
+	} else {
+		record = p;
+	}
+
+	save_record();
+}
+
+static void check_flush(void)
+{
+	if (++record.unsaved < PUNCTUALITY_FLUSH_EVERY)
+		save_record();
+	else
+		flush_punctuality();
+}
+
+void record_lateness(u32 ms)
+{
+	size_t i;
+
+	for_each_idx(i, sizeof_array(bounds)) {
+		if (ms < bounds[i])
+			break;
+	}
+
+	record.bucket[i]++;
+	record.sent++;
+	record.late_sum += ms;
+	if (ms > record.late_max)
+		record.late_max = ms;
+
+	check_flush();
+}
+
+void record_skip(u32 n)
+{
+	if (!n)
+		return;
+
+	record.skipped += n;
+	check_flush();
+}
+
+int flush_punctuality(void)
+{
+	nvs_handle_t nvs;
+	u16 unsaved = record.unsaved;
+	int err;
+
+	/* warm wake-ups leave nvs alone, a later boot flushes */
+	if (!unsaved || !is_nvs_ready())
+		return 0;
+
+	record.unsaved = 0;
+	save_record();
+
+	err = nvs_open(PUNCTUALITY_NAMESPACE, NVS_READWRITE, &nvs);
+	if (err)
+		goto err_open;
+
+	err = nvs_set_blob(nvs, PUNCTUALITY_KEY, &record, sizeof(record)) ||
+	      nvs_commit(nvs);
+	nvs_close(nvs);
+	if (err)
+		goto err_open;
+
+	return 0;
+
+err_open:
+	/* kept in rtc memory, the next record tries again */
+	record.unsaved = unsaved;
+	save_record();
+	return warning(TAG, "failed to flush %u records to nvs", unsaved);
+}
+
+void get_punctuality(struct punctuality *p)
+{
+	*p = record;
+}
+
+void print_punctuality(void)
+{
+	size_t i;
+	u32 lower = 0;
+
+	info(TAG, "%" PRIu32 " entries sent, %" PRIu32 " skipped",
+	     record.sent, record.skipped);
+
+	if (!record.sent)
+		return;
+
+	info(TAG, "lateness avg %" PRIu64 "ms, max %" PRIu32 "ms",
+	     record.late_sum / record.sent, record.late_max);
+
+	for_each_idx(i, sizeof_array(bounds)) {
+		info(TAG, "%5" PRIu32 " - %5" PRIu32 "ms %8" PRIu32,
+		     lower, bounds[i], record.bucket[i]);
+		lower = bounds[i];
+	}
+
+	info(TAG, "%5" PRIu32 " -    ...ms %8" PRIu32,
+	     lower, record.bucket[i]);
+}
@@ -0,0 +1,63 @@
+/****************************************************************************
+**
+** Copyright 2024 Jiamu Sun
+** Contact: barroit@linux.com
+**
+** This file is part of livaut.
+**
+** livaut is free software: you can redistribute it and/or modify it
+** under the terms of the GNU General Public License as published by the
+** Free Software Foundation, either version 3 of the License, or (at your
+** option) any later version.
+**
+** livaut is distributed in the hope that it will be useful, but
+** WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+** General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License along
+** with livaut. If not, see <https://www.gnu.org/licenses/>.
+**
+****************************************************************************/
+
+#ifndef PUNCTUALITY_H
+#define PUNCTUALITY_H
+
+#include "types.h"
+
+/* upper bounds (ms) of the lateness buckets, the last one is open */
+#define PUNCTUALITY_BOUNDS { 100, 250, 500, 1000, 2000, 3000, 5000 }
+#define PUNCTUALITY_BUCKETS 8
+
+/*
+ * how late scheduled entries go out, kept in rtc memory across deep sleep
+ * and flushed to nvs every few records, so a power loss costs at most
+ * those few
+ */
+struct punctuality {
+	u16 version;
+	u16 unsaved;  /* records since the last flush */
+	u32 sent;     /* entries sent */
+	u32 skipped;  /* schedules given up, see SCHEDULE_TOLERANCE */
+	u32 late_max; /* ms */
+	u64 late_sum; /* ms */
+	u32 bucket[PUNCTUALITY_BUCKETS];
+	u32 crc;      /* of the fields above */
+};
+
+/* takes the copy in nvs when the one in rtc memory did not survive */
+void load_punctuality(void);
+
+/* ms is the time an entry went out minus its start */
+void record_lateness(u32 ms);
+
+/* n schedules went by without being sent */
+void record_skip(u32 n);
+
+int flush_punctuality(void);
+
+void get_punctuality(struct punctuality *p);
+
+void print_punctuality(void);
+
+#endif /* PUNCTUALITY_H */
@@ -0,0 +1,497 @@
+/****************************************************************************
+**
+** Copyright 2024 Jiamu Sun
+** Contact: barroit@linux.com
+**
+** This file is part of livaut.
+**
+** livaut is free software: you can redistribute it and/or modify it
+** under the terms of the GNU General Public License as published by the
+** Free Software Foundation, either version 3 of the License, or (at your
+** option) any later version.
+**
+** livaut is distributed in the hope that it will be useful, but
+** WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+** General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License along
+** with livaut. If not, see <https://www.gnu.org/licenses/>.
+**
+****************************************************************************/
+
+#include "schedule.h"
+#include "signal-schedule.h"
+#include "termio.h"
+#include "memory.h"
+#include "list.h"
+#include "esp_partition.h"
+#include "esp_rom_crc.h"
+#include <string.h>
+#include <stddef.h>
+
+#define TAG "schedule"
+
+/* subtype of the schedule partitions in partitions.csv */
+#define SCHEDULE_PARTITION_SUBTYPE 0x40
+
+#define CRC_OFFSET offsetof(struct schedule_header, size)
+
+#define FLASH_SECTOR_SIZE 4096
+
+#define to_sector_boundary(a) \
+	(((a) + FLASH_SECTOR_SIZE - 1) & ~(FLASH_SECTOR_SIZE - 1))
+
+static const char *slot_labels[] = {
+	"schedule_a",
+	"schedule_b",
+};
+
+struct schedule_slot {
+	const esp_partition_t *part;
+	esp_partition_mmap_handle_t map;
+	const struct schedule_header *image;
+};
+
+static const struct schedule_header *image = (const void *)schedule_blob;
+static struct schedule_slot active = { 0 };
+
+static struct {
+	const esp_partition_t *part;
+	struct schedule_header head;
+	size_t off;
+	u32 crc;
+} upload;
+
+static const struct signal_schedule *
+schedules_of(const struct schedule_header *h)
+{
+	return (const void *)&h[1];
+}
+
+static const struct frame_info *frames_of(const struct schedule_header *h)
+{
+	return (const void *)&schedules_of(h)[h->entries];
+}
+
+static const struct schedule_wheel *wheel_of(const struct schedule_header *h)
+{
+	return (const void *)&frames_of(h)[h->frames];
+}
+
+static const u16 *events_of(const struct schedule_header *h)
+{
+	return (const void *)&wheel_of(h)[1];
+}
+
+static const struct schedule_rule *rules_of(const struct schedule_header *h)
+{
+	return (const void *)&events_of(h)[h->events];
+}
+
+static const u8 *payload_of(const struct schedule_header *h)
+{
+	return (const void *)&rules_of(h)[h->rules];
+}
+
+static size_t get_image_size(const struct schedule_header *h)
+{
+	return sizeof(*h) + h->entries * sizeof(struct signal_schedule) +
+	       h->frames * sizeof(struct frame_info) +
+	       sizeof(struct schedule_wheel) + h->events * sizeof(u16) +
+	       h->rules * sizeof(struct schedule_rule) + h->payload;
+}
+
+static int check_header(const struct schedule_header *h, size_t cap)
+{
+	if (h->magic != SCHEDULE_MAGIC || h->version != SCHEDULE_VERSION)
+		return 1;
+
+	if ((!h->entries && !h->rules) || h->rules > SCHEDULE_RULES_MAX)
+		return 1;
+
+	return h->size > cap || h->size != get_image_size(h);
+}
+
+/*
+ * the firmware is built for the largest frame of its own schedule, frames
+ * of an uploaded image must fit in struct tx_frame as well
+ */
+static int check_frames(const struct schedule_header *h)
+{
+	const struct signal_schedule *s = schedules_of(h);
+	const struct frame_info *f = frames_of(h);
+	const struct schedule_rule *r = rules_of(h);
+	size_t i;
+
+	for_each_idx(i, h->entries) {
+		if (s[i].start >= 86400 || (i && s[i].start <= s[i - 1].start))
+			return error(TAG, "entry %zu is out of order", i);
+		if (!s[i].fnum || s[i].frame + s[i].fnum > h->frames)
+			return error(TAG, "entry %zu has no frames", i);
+	}
+
+	for_each_idx(i, h->rules) {
+		if (r[i].base.start > r[i].end || r[i].end >= 86400 ||
+		    !r[i].period)
+			return error(TAG, "rule %zu has no valid time", i);
+		if (!r[i].base.fnum ||
+		    r[i].base.frame + r[i].base.fnum > h->frames)
+			return error(TAG, "rule %zu has no frames", i);
+	}
+
+	for_each_idx(i, h->frames) {
+		if (f[i].proto >= IR_PROTOCOL_NUM ||
+		    f[i].cnum + f[i].unum > FRAME_BYTES_MAX ||
+		    f[i].bnum > FRAME_BITS_MAX)
+			return error(TAG, "frame %zu is not supported", i);
+		if (f[i].code + f[i].cnum > h->payload ||
+		    f[i].data + f[i].unum > h->payload ||
+		    f[i].bits + (f[i].bnum + 7) / 8 > h->payload)
+			return error(TAG, "frame %zu is out of bounds", i);
+	}
+
+	return 0;
+}
+
+/* find_schedule() trusts the wheel, so does anything it returns */
+static int check_wheel(const struct schedule_header *h)
+{
+	const struct schedule_wheel *w = wheel_of(h);
+	const u16 *ev = events_of(h);
+	size_t d, i;
+
+	if (w->day[0] || w->day[WHEEL_DAYS] != h->events)
+		return error(TAG, "time-wheel does not cover all events");
+
+	for_each_idx(d, WHEEL_DAYS) {
+		if (w->day[d] > w->day[d + 1] || w->next_day[d] > WHEEL_DAYS)
+			return error(TAG, "day %zu of the time-wheel is bad", d);
+
+		for_each_idx(i, WHEEL_BUCKETS)
+			if (w->bucket[d][i] < w->day[d] ||
+			    w->bucket[d][i] > w->day[d + 1])
+				return error(TAG, "bucket %zu of day %zu is "
+					     "out of bounds", i, d);
+	}
+
+	for_each_idx(i, h->events)
+		if (ev[i] >= h->entries)
+			return error(TAG, "event %zu is out of bounds", i);
+
+	return 0;
+}
+
+static int check_image(const struct schedule_header *h, size_t cap)
+{
+	if (check_header(h, cap))
+		return 1;
+
+	if (esp_rom_crc32_le(0, (const u8 *)h + CRC_OFFSET,
+			     h->size - CRC_OFFSET) != h->crc)
+		return 1;
+
+	return check_frames(h) || check_wheel(h);
+}
+
+static int map_slot(struct schedule_slot *slot, const char *label)
+{
+	int err;
+	const void *ptr;
+
+	slot->part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA,
+					      SCHEDULE_PARTITION_SUBTYPE,
+					      label);
+	if (!slot->part)
+		return 1;
+
+	err = CE(esp_partition_mmap(slot->part, 0, slot->part->size,
+				    ESP_PARTITION_MMAP_DATA, &ptr,
+				    &slot->map));
+	if (err)
+		return 1;
+
+	slot->image = ptr;
+	if (check_image(slot->image, slot->part->size)) {
+		esp_partition_munmap(slot->map);
+		return 1;
+	}
+
+	return 0;
+}
+
+static int is_newer(const struct schedule_slot *a,
+		    const struct schedule_slot *b)
+{
+	return !b->image ||
+	       (int32_t)(a->image->sequence - b->image->sequence) > 0;
+}
+
+void load_schedule(void)
+{
+	struct schedule_slot best = { 0 }, slot;
+	size_t i;
+
+	for_each_idx(i, sizeof_array(slot_labels)) {
+		if (map_slot(&slot, slot_labels[i]))
+			continue;
+
+		if (is_newer(&slot, &best)) {
+			if (best.image)
+				esp_partition_munmap(best.map);
+			best = slot;
+		} else {
+			esp_partition_munmap(slot.map);
+		}
+	}
+
+	if (active.image)
+		esp_partition_munmap(active.map);
+	active = best;
+
+	if (!active.image) {
+		image = (const void *)schedule_blob;
+		info(TAG, "using the built-in schedule");
+		return;
+	}
+
+	image = active.image;
+	info(TAG, "using schedule %" PRIu32 " from %s",
+	     image->sequence, active.part->label);
+}
+
+size_t get_schedule_num(void)
+{
+	return image->entries;
+}
+
+const struct signal_schedule *get_schedule(size_t idx)
+{
+	return &schedules_of(image)[idx];
+}
+
+size_t get_rule_num(void)
+{
+	return image->rules;
+}
+
+const struct signal_schedule *get_rule(size_t idx)
+{
+	return &rules_of(image)[idx].base;
+}
+
+/* the first time of rule r at or after sec, or SCHEDULE_NONE */
+static u32 next_rule_time(const struct schedule_rule *r, u32 sec)
+{
+	u32 t = r->base.start;
+
+	if (sec > t)
+		t += (sec - t + r->period - 1) / r->period * r->period;
+
+	return t <= r->end ? t : SCHEDULE_NONE;
+}
+
+/* the first time on wday at or after sec, or SCHEDULE_NONE */
+static u32 next_due_time(u32 sec, u8 wday)
+{
+	const struct schedule_wheel *w = wheel_of(image);
+	const struct signal_schedule *s = schedules_of(image);
+	const struct schedule_rule *r = rules_of(image);
+	const u16 *ev = events_of(image);
+	u32 end = w->day[wday + 1];
+	u32 i = sec < 86400 ? w->bucket[wday][sec / 3600] : end;
+	u32 t, due = SCHEDULE_NONE;
+
+	/* the bucket leaves at most an hour of entries to walk */
+	while (i < end && s[ev[i]].start < sec)
+		i++;
+
+	if (i < end)
+		due = s[ev[i]].start;
+
+	for_each_idx(i, image->rules) {
+		if (!(r[i].base.days & (64 >> wday)))
+			continue;
+
+		t = next_rule_time(&r[i], sec);
+		if (t < due)
+			due = t;
+	}
+
+	return due;
+}
+
+u32 find_schedule(u32 sec, u8 wday, u8 *ahead)
+{
+	const struct schedule_wheel *w = wheel_of(image);
+	u32 due = next_due_time(sec, wday);
+
+	*ahead = 0;
+	if (due != SCHEDULE_NONE || !w->next_day[wday])
+		return due;
+
+	/* any day in next_day has something due from its midnight on */
+	*ahead = w->next_day[wday];
+	return next_due_time(0, (wday + *ahead) % WHEEL_DAYS);
+}
+
+size_t get_due_schedules(u32 sec, u8 wday,
+			 const struct signal_schedule **list)
+{
+	const struct schedule_wheel *w = wheel_of(image);
+	const struct signal_schedule *s = schedules_of(image);
+	const struct schedule_rule *r = rules_of(image);
+	const u16 *ev = events_of(image);
+	u32 end = w->day[wday + 1];
+	u32 i = w->bucket[wday][sec / 3600];
+	size_t n = 0;
+
+	while (i < end && s[ev[i]].start < sec)
+		i++;
+
+	if (i < end && s[ev[i]].start == sec)
+		list[n++] = &s[ev[i]];
+
+	for_each_idx(i, image->rules)
+		if ((r[i].base.days & (64 >> wday)) &&
+		    next_rule_time(&r[i], sec) == sec)
+			list[n++] = &r[i].base;
+
+	return n;
+}
+
+u32 count_due_schedules(u32 sec, u32 end, u8 wday)
+{
+	const struct signal_schedule *list[SCHEDULE_DUE_MAX];
+	u32 t, n = 0;
+
+	for (t = next_due_time(sec, wday); t < end;
+	     t = next_due_time(t + 1, wday))
+		n += get_due_schedules(t, wday, list);
+
+	return n;
+}
+
+const struct frame_info *get_frame(const struct signal_schedule *s,
+				   size_t idx)
+{
+	return &frames_of(image)[s->frame + idx];
+}
+
+void load_frame(struct tx_frame *dest, const struct frame_info *frame)
+{
+	const u8 *pl = payload_of(image);
+
+	dest->cnum  = frame->cnum;
+	dest->unum  = frame->unum;
+	dest->bnum  = frame->bnum;
+	dest->delay = frame->delay;
+	dest->proto = frame->proto;
+
+	memcpy(dest->bytes, &pl[frame->code], frame->cnum);
+	memcpy(&dest->bytes[frame->cnum], &pl[frame->data], frame->unum);
+
+	if (frame->bnum)
+		make_bit_symbols(dest->bits, &pl[frame->bits],
+				 frame->bnum, frame->proto);
+}
+
+u32 get_schedule_sequence(void)
+{
+	return active.image ? image->sequence : 0;
+}
+
+u32 get_schedule_crc(void)
+{
+	return image->crc;
+}
+
+static const esp_partition_t *get_spare_slot(void)
+{
+	const esp_partition_t *part;
+	size_t i;
+
+	for_each_idx(i, sizeof_array(slot_labels)) {
+		part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA,
+						SCHEDULE_PARTITION_SUBTYPE,
+						slot_labels[i]);
+		if (part && part != active.part)
+			return part;
+	}
+
+	return NULL;
+}
+
+int begin_schedule_upload(const struct schedule_header *head)
+{
+	int err;
+	const esp_partition_t *part = get_spare_slot();
+
+	if (!part)
+		return error(TAG, "no schedule partition to upload to");
+
+	if (check_header(head, part->size))
+		return error(TAG, "invalid schedule header");
+
+	/* the magic goes last, the slot stays invalid until then */
+	err = CE(esp_partition_erase_range(part, 0,
+				   to_sector_boundary(head->size)));
+	if (err)
+		return 1;
+
+	upload.part = part;
+	upload.head = *head;
+	upload.off  = sizeof(*head);
+	upload.crc  = esp_rom_crc32_le(0, (const u8 *)head + CRC_OFFSET,
+				       sizeof(*head) - CRC_OFFSET);
+
+	return 0;
+}
+
+int write_schedule_upload(const void *buf, size_t n)
+{
+	int err;
+
+	if (upload.off + n > upload.head.size)
+		return error(TAG, "schedule image longer than %" PRIu32,
+			     upload.head.size);
+
+	err = CE(esp_partition_write(upload.part, upload.off, buf, n));
+	if (err)
+		return 1;
+
+	upload.off += n;
+	upload.crc = esp_rom_crc32_le(upload.crc, buf, n);
+
+	return 0;
+}
+
+int end_schedule_upload(void)
+{
+	int err;
+	struct schedule_header *head = &upload.head;
+	u32 magic = head->magic;
+
+	if (upload.off != head->size)
+		return error(TAG, "schedule image is truncated");
+	if (upload.crc != head->crc)
+		return error(TAG, "schedule image crc mismatch");
+
+	head->sequence = get_schedule_sequence() + 1;
+
+	err = CE(esp_partition_write(upload.part, sizeof(magic),
+				     (const u8 *)head + sizeof(magic),
+				     sizeof(*head) - sizeof(magic)));
+	if (err)
+		return 1;
+
+	err = CE(esp_partition_write(upload.part, 0, &magic, sizeof(magic)));
+	if (err)
+		return 1;
+
+	load_schedule();
+	if (active.part != upload.part)
+		return error(TAG, "uploaded schedule is not usable");
+
+	return 0;
+}
@@ -0,0 +1,112 @@
+/****************************************************************************
+**
+** Copyright 2024 Jiamu Sun
+** Contact: barroit@linux.com
+**
+** This file is part of livaut.
+**
+** livaut is free software: you can redistribute it and/or modify it
+** under the terms of the GNU General Public License as published by the
+** Free Software Foundation, either version 3 of the License, or (at your
+** option) any later version.
+**
+** livaut is distributed in the hope that it will be useful, but
+** WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+** General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License along
+** with livaut. If not, see <https://www.gnu.org/licenses/>.
+**
+****************************************************************************/
+
+#ifndef SCHEDULE_H
+#define SCHEDULE_H
+
+#include "types.h"
+#include "signal-schedule-def.h"
+#include "ir-protocol.h"
+
+/*
+ * the schedule is read in place from flash, see schedule_header in
+ * signal-schedule-def.h for the layout
+ *
+ * images uploaded to the schedule partitions take precedence over the one
+ * built into the firmware
+ */
+
+void load_schedule(void);
+
+size_t get_schedule_num(void);
+
+const struct signal_schedule *get_schedule(size_t idx);
+
+/* ‘every’ rules, base of a rule is what is sent at each of its times */
+size_t get_rule_num(void);
+
+const struct signal_schedule *get_rule(size_t idx);
+
+#define SCHEDULE_NONE UINT32_MAX
+
+/* at most one entry and every rule are due at the same second */
+#define SCHEDULE_DUE_MAX (1 + SCHEDULE_RULES_MAX)
+
+/*
+ * the second of the next time something is due at or after sec of weekday
+ * wday (0 is monday), on the day *ahead days from wday, or SCHEDULE_NONE
+ *
+ * entries come from the weekly time-wheel and rules are expanded on the
+ * fly, the cost does not depend on the length of the week or how often a
+ * rule repeats
+ */
+u32 find_schedule(u32 sec, u8 wday, u8 *ahead);
+
+/* what is due at sec of weekday wday, list has SCHEDULE_DUE_MAX room */
+size_t get_due_schedules(u32 sec, u8 wday,
+			 const struct signal_schedule **list);
+
+/* how many schedules are due on weekday wday from sec up to but not at end */
+u32 count_due_schedules(u32 sec, u32 end, u8 wday);
+
+/* the idx-th frame of schedule s */
+const struct frame_info *get_frame(const struct signal_schedule *s,
+				   size_t idx);
+
+/* copies the frame out of flash into something the encoder can send */
+void load_frame(struct tx_frame *dest, const struct frame_info *frame);
+
+/* sequence number of the schedule in use, 0 for the built-in one */
+u32 get_schedule_sequence(void);
+
+u32 get_schedule_crc(void);
+
+/*
+ * an upload writes the image to the slot not in use, and switches to it in
+ * end_schedule_upload() once the crc matches
+ */
+int begin_schedule_upload(const struct schedule_header *head);
+
+int write_schedule_upload(const void *buf, size_t n);
+
+int end_schedule_upload(void);
+
+#define SCHEDULER_STATE_VERSION 3
+
+/*
+ * kept in rtc memory by the schedule_signal action during deep sleep, it is
+ * only a cache of find_schedule(), anything that does not match (power
+ * loss, a new day, an uploaded schedule) makes it look the position up
+ * again
+ */
+struct scheduler_state {
+	u16 version;
+	u8 ahead;      /* days from day to due */
+	u8 reserved;
+	u32 day;       /* get_day_stamp() */
+	u32 due;       /* second of the next due time, or SCHEDULE_NONE */
+	u32 sequence;  /* of the schedule image next refers to */
+	u32 image_crc;
+	u32 crc;       /* of the fields above */
+};
+
+#endif /* SCHEDULE_H */
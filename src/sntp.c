@@ -22,22 +22,162 @@
 
 #include "sntp.h"
 #include "wifi.h"
+#include "nvs.h"
 #include "esp_netif_sntp.h"
+#include "esp_sntp.h"
+#include "nvs_flash.h"
 #include "termio.h"
+#include "esp_attr.h"
+#include "esp_rom_crc.h"
 #include "time.h"
+#include <sys/time.h>
 #include <assert.h>
+#include <stddef.h>
+#include <string.h>
 
 #define TAG "sntp_service"
 
 #define SNTP_DEFAULT_CONFIG ESP_NETIF_SNTP_DEFAULT_CONFIG
 
+#define SYNC_STATE_VERSION 2
+
+/* a drift measured over less sleep than this is mostly noise, in ms */
+#define DRIFT_MIN_SLEEP (3600 * 1000)
+
+/* ppb, a fit beyond this is a clock set by hand or a bad sync */
+#define DRIFT_MAX 50000000
+
+#define DRIFT_NAMESPACE "sntp"
+#define DRIFT_KEY       "drift"
+
 static int is_service_started;
 
+static RTC_DATA_ATTR struct sync_state sync;
+
+static u32 get_sync_crc(void)
+{
+	return esp_rom_crc32_le(0, (const u8 *)&sync,
+				offsetof(struct sync_state, crc));
+}
+
+static int is_sync_valid(void)
+{
+	return sync.version == SYNC_STATE_VERSION &&
+	       sync.crc == get_sync_crc();
+}
+
+static void save_sync(void)
+{
+	sync.crc = get_sync_crc();
+}
+
+static u64 get_epoch_ms(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return (u64)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+}
+
+/* after a power loss only the drift is left, in nvs */
+static void load_drift(void)
+{
+	nvs_handle_t nvs;
+	s32 drift;
+	int err;
+
+	memset(&sync, 0, sizeof(sync));
+	sync.version = SYNC_STATE_VERSION;
+
+	if (is_nvs_ready() &&
+	    !nvs_open(DRIFT_NAMESPACE, NVS_READONLY, &nvs)) {
+		err = nvs_get_i32(nvs, DRIFT_KEY, &drift);
+		nvs_close(nvs);
+
+		if (!err) {
+			sync.drift = drift;
+			sync.samples = 1;
+		}
+	}
+
+	save_sync();
+}
+
+static void store_drift(void)
+{
+	nvs_handle_t nvs;
+	int err;
+
+	if (!is_nvs_ready())
+		return;
+
+	err = nvs_open(DRIFT_NAMESPACE, NVS_READWRITE, &nvs);
+	if (err)
+		goto err_store;
+
+	err = nvs_set_i32(nvs, DRIFT_KEY, sync.drift) || nvs_commit(nvs);
+	nvs_close(nvs);
+	if (err)
+		goto err_store;
+
+	return;
+
+err_store:
+	warning(TAG, "failed to store the rtc drift");
+}
+
+/* error is how many µs the system time was ahead of ntp */
+static void fit_drift(s64 error)
+{
+	s64 sample;
+
+	if (sync.slept < DRIFT_MIN_SLEEP)
+		return;
+
+	/* as if nothing was taken off the time since the last sync */
+	sample = (error + sync.fixed) * 1000000 / (s64)sync.slept;
+	if (sample > DRIFT_MAX || sample < -DRIFT_MAX) {
+		warning(TAG, "ignored an rtc drift of %" PRId64 " ppb", sample);
+		return;
+	}
+
+	sync.drift = sync.samples ? (sync.drift * 3 + sample) / 4 : sample;
+	sync.samples++;
+
+	info(TAG, "rtc drift %" PRId64 " ppb, fitted to %" PRId32 " ppb",
+	     sample, sync.drift);
+
+	store_drift();
+}
+
+/* replaces the weak one of lwip, tv is the time from ntp */
+void sntp_sync_time(struct timeval *tv)
+{
+	struct timeval now;
+
+	gettimeofday(&now, NULL);
+
+	if (is_sync_valid() && sync.last_sync)
+		fit_drift((s64)(now.tv_sec - tv->tv_sec) * 1000000 +
+			  (now.tv_usec - tv->tv_usec));
+
+	settimeofday(tv, NULL);
+	sntp_set_sync_status(SNTP_SYNC_STATUS_COMPLETED);
+
+	sync.last_sync = tv->tv_sec;
+	sync.slept = 0;
+	sync.fixed = 0;
+	save_sync();
+}
+
 void config_sntp_service(void)
 {
 	esp_sntp_config_t conf = SNTP_DEFAULT_CONFIG(CONFIG_NTP_SERVER);
 	conf.start = false;
 
+	if (!is_sync_valid())
+		load_drift();
+
 	esp_netif_sntp_init(&conf);
 }
 
@@ -47,7 +187,8 @@ int start_sntp_service(void)
 
 	esp_netif_sntp_start();
 
-	err = esp_netif_sntp_sync_wait(pdMS_TO_TICKS(10000));
+	err = esp_netif_sntp_sync_wait(
+		pdMS_TO_TICKS(CONFIG_SNTP_SYNC_TIMEOUT * 1000));
 	if (err) {
 		warning(TAG, "failed to synchronize system time from %s",
 			CONFIG_NTP_SERVER);
@@ -63,6 +204,11 @@ int start_sntp_service(void)
 	return 0;
 }
 
+void stop_sntp_service(void)
+{
+	esp_netif_sntp_deinit();
+}
+
 void collaborate_timezone(void)
 {
 	setenv("TZ", CONFIG_LOCAL_TIMEZONE, 1);
@@ -75,10 +221,16 @@ static struct tm *get_tm_now(void)
 	return localtime(&now);
 }
 
-u8 get_day_of_week(void)
+u8 get_weekday(void)
 {
 	struct tm *t = get_tm_now();
-	return 128 >> t->tm_wday;
+	return (t->tm_wday + 6) % 7;
+}
+
+u8 get_day_of_week(void)
+{
+	/* monday is the highest bit, as in schedule.in */
+	return 64 >> get_weekday();
 }
 
 u64 get_seconds_of_day(void)
@@ -87,7 +239,101 @@ u64 get_seconds_of_day(void)
 	return (t->tm_hour * 3600) + (t->tm_min * 60) + t->tm_sec;
 }
 
+u32 get_ms_of_day(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+
+	struct tm *t = localtime(&tv.tv_sec);
+	u32 sec = (t->tm_hour * 3600) + (t->tm_min * 60) + t->tm_sec;
+
+	return sec * 1000 + tv.tv_usec / 1000;
+}
+
+u32 get_day_stamp(void)
+{
+	struct tm *t = get_tm_now();
+	return t->tm_year * 366 + t->tm_yday;
+}
+
 int is_sntp_started(void)
 {
 	return is_service_started;
 }
+
+/*
+ * ms the time may be off by after ms more of deep sleep, the rtc drifts
+ * only in deep sleep
+ */
+static u64 get_clock_error(u64 ms)
+{
+	u64 ppm = sync.samples ? CONFIG_SNTP_RESIDUAL_PPM :
+				 CONFIG_SNTP_DRIFT_PPM;
+
+	return (sync.slept + ms) * ppm / 1000000;
+}
+
+int is_clock_trusted_after(u64 seconds)
+{
+	return is_sync_valid() && sync.last_sync &&
+	       get_clock_error(seconds * 1000) < CONFIG_SNTP_DRIFT_BUDGET;
+}
+
+int is_clock_trusted(void)
+{
+	return is_clock_trusted_after(0);
+}
+
+void mark_sleep_start(void)
+{
+	if (!is_sync_valid())
+		return;
+
+	sync.sleep_start = get_epoch_ms();
+	save_sync();
+}
+
+void correct_clock_drift(void)
+{
+	struct timeval tv;
+	u64 now, slept;
+	s64 fix, us;
+
+	if (!is_sync_valid() || !sync.sleep_start)
+		return;
+
+	gettimeofday(&tv, NULL);
+	now = (u64)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+	slept = now > sync.sleep_start ? now - sync.sleep_start : 0;
+
+	sync.sleep_start = 0;
+	sync.slept += slept;
+
+	/* ms times ppb is µs over 10^6 */
+	fix = (s64)slept * sync.drift / 1000000;
+	if (fix) {
+		us = (s64)tv.tv_sec * 1000000 + tv.tv_usec - fix;
+		tv.tv_sec = us / 1000000;
+		tv.tv_usec = us % 1000000;
+		settimeofday(&tv, NULL);
+
+		sync.fixed += fix;
+	}
+
+	save_sync();
+}
+
+u64 fix_sleep_duration(u64 us)
+{
+	if (!is_sync_valid())
+		return us;
+
+	/* a fast rtc counts the time it was asked for too soon */
+	return us + (s64)us * sync.drift / 1000000000;
+}
+
+int is_clock_valid(void)
+{
+	return is_service_started || is_clock_trusted();
+}
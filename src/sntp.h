@@ -25,17 +25,65 @@
 
 #include "types.h"
 
+/*
+ * kept in rtc memory, the rtc keeps the system time during deep sleep, and
+ * gains drift ppb there, it is fitted at each sync and kept in nvs too
+ */
+struct sync_state {
+	u32 version;
+	s32 drift;
+	u32 samples;     /* syncs the drift is fitted to */
+	u32 reserved;
+	u64 last_sync;   /* epoch seconds */
+	u64 sleep_start; /* epoch ms, 0 when awake */
+	u64 slept;       /* ms in deep sleep since the last sync */
+	s64 fixed;       /* µs taken off the time since the last sync */
+	u32 crc;         /* of the fields above */
+};
+
 void config_sntp_service(void);
 
 int start_sntp_service(void);
 
+/* no more syncs until the next config_sntp_service() */
+void stop_sntp_service(void);
+
 /* do not call this function in task */
 void collaborate_timezone(void);
 
+/* 0 is monday */
+u8 get_weekday(void);
+
 u8 get_day_of_week(void);
 
 u64 get_seconds_of_day(void);
 
+u32 get_ms_of_day(void);
+
+/* changes once a day at local midnight */
+u32 get_day_stamp(void);
+
 int is_sntp_started(void);
 
+/*
+ * whether the time of the last sync, carried through deep sleep by the rtc,
+ * is still within CONFIG_SNTP_DRIFT_BUDGET
+ */
+int is_clock_trusted(void);
+
+/* whether it still is after a deep sleep of seconds */
+int is_clock_trusted_after(u64 seconds);
+
+/* called right before deep sleep */
+void mark_sleep_start(void);
+
+/* called on boot, takes the drift of the sleep off the system time */
+void correct_clock_drift(void);
+
+/* µs to ask the rtc for, to sleep us of real time */
+u64 fix_sleep_duration(u64 us);
+
+/* synchronized in this boot, or trusted */
+int is_clock_valid(void);
+
 #endif /* SNTP_H */
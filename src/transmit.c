@@ -0,0 +1,286 @@
+/****************************************************************************
+**
+** Copyright 2024 Jiamu Sun
+** Contact: barroit@linux.com
+**
+** This file is part of livaut.
+**
+** livaut is free software: you can redistribute it and/or modify it
+** under the terms of the GNU General Public License as published by the
+** Free Software Foundation, either version 3 of the License, or (at your
+** option) any later version.
+**
+** livaut is distributed in the hope that it will be useful, but
+** WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+** General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License along
+** with livaut. If not, see <https://www.gnu.org/licenses/>.
+**
+****************************************************************************/
+
+#include "transmit.h"
+#include "ir-protocol.h"
+#include "schedule.h"
+#include "rmt.h"
+#include "termio.h"
+#include "esp_attr.h"
+#include "esp_timer.h"
+#include "memory.h"
+#include "power-lock.h"
+#include <string.h>
+
+#define TAG "transmitter"
+
+static rmt_channel_handle_t tx_channel;
+static rmt_encoder_handle_t encoder;
+static int carrier = -1;
+
+/*
+ * the channel is enabled only from the first frame queued to the last one
+ * done, the driver holds the apb at its maximum as long as it is
+ */
+static int is_bursting;
+
+/*
+ * start time of each frame in flight, frames complete in the order they are
+ * queued, so a ring indexed by sequence number is enough
+ */
+static u64 frame_start[TRANSFER_SLOTS];
+
+/*
+ * frames are loaded out of flash into here, a slot is reused only after the
+ * frame in it is done, rmt_transmit() blocks before that happens
+ */
+static struct tx_frame slots[TRANSFER_SLOTS];
+static u32 next_start;
+static volatile u32 next_done;
+
+static struct transmit_stats stats;
+
+static rmt_tx_channel_config_t get_chan_conf(void)
+{
+	rmt_tx_channel_config_t conf = {
+		.clk_src           = RMT_CLOCK_SOURCE,
+		.gpio_num          = CONFIG_RMT_TX_GPIO,
+		.mem_block_symbols = RMT_MEMORY_BLOCK_SIZE,
+		.resolution_hz     = RMT_CLOCK_RESOLUTION,
+		.trans_queue_depth = TRANSFER_QUEUE_DEPTH,
+	};
+
+	return conf;
+}
+
+static rmt_carrier_config_t get_carr_conf(enum ir_protocol_id id)
+{
+	const struct ir_protocol *p = get_ir_protocol(id);
+	FIELD_TYPEOF(rmt_carrier_config_t, flags) flag = {
+		.polarity_active_low = false,
+	};
+
+	rmt_carrier_config_t conf = {
+		.duty_cycle   = p->duty_cycle,
+		.frequency_hz = p->frequency,
+		.flags        = flag,
+	};
+
+	return conf;
+}
+
+static int apply_carrier(enum ir_protocol_id id)
+{
+	int err;
+
+	/* nothing to do if the carrier is already applied */
+	if (carrier == id)
+		return 0;
+
+	rmt_carrier_config_t carr_conf = get_carr_conf(id);
+	err = CE(rmt_apply_carrier(tx_channel, &carr_conf));
+	if (err)
+		return 1;
+
+	carrier = id;
+	return 0;
+}
+
+static bool IRAM_ATTR record_frame_done(rmt_channel_handle_t,
+					const rmt_tx_done_event_data_t *,
+					void *)
+{
+	size_t idx = next_done++ % sizeof_array(frame_start);
+	u64 lat = esp_timer_get_time() - frame_start[idx];
+
+	stats.done++;
+	stats.latency_sum += lat;
+	if (lat > stats.latency_max)
+		stats.latency_max = lat;
+
+	return false;
+}
+
+static rmt_tx_event_callbacks_t get_cb_conf(void)
+{
+	rmt_tx_event_callbacks_t conf = {
+		.on_trans_done = record_frame_done,
+	};
+
+	return conf;
+}
+
+int setup_transmitter(void)
+{
+	int err;
+
+	rmt_tx_channel_config_t chan_conf = get_chan_conf();
+	err = CE(rmt_new_tx_channel(&chan_conf, &tx_channel));
+	if (err)
+		return 1;
+
+	rmt_tx_event_callbacks_t cb_conf = get_cb_conf();
+	err = CE(rmt_tx_register_event_callbacks(tx_channel, &cb_conf, NULL));
+	if (err)
+		return 1;
+
+	err = apply_carrier(IR_AEHA);
+	if (err)
+		return 1;
+
+	err = CE(make_ir_encoder(&encoder));
+	if (err)
+		return 1;
+
+	reset_transmit_stats();
+
+	return 0;
+}
+
+int teardown_transmitter(void)
+{
+	int err;
+
+	err = wait_transmit_done();
+	if (err)
+		return 1;
+
+	err = CE(rmt_del_channel(tx_channel));
+	if (err)
+		return 1;
+
+	err = CE(encoder->del(encoder));
+	if (err)
+		return 1;
+
+	carrier = -1;
+
+	return 0;
+}
+
+static int start_burst(void)
+{
+	int err;
+
+	if (is_bursting)
+		return 0;
+
+	hold_power_lock(LOCK_TX_BURST);
+
+	err = CE(rmt_enable(tx_channel));
+	if (err) {
+		release_power_lock(LOCK_TX_BURST);
+		return 1;
+	}
+
+	is_bursting = 1;
+	return 0;
+}
+
+static int end_burst(void)
+{
+	int err;
+
+	err = CE(rmt_disable(tx_channel));
+
+	is_bursting = 0;
+	release_power_lock(LOCK_TX_BURST);
+
+	return err != 0;
+}
+
+static int wait_queue_empty(void)
+{
+	return CE(rmt_tx_wait_all_done(tx_channel, -1)) != 0;
+}
+
+static int queue_frame(const frame_info_t *frame)
+{
+	int err;
+	rmt_transmit_config_t conf = { 0 };
+	struct tx_frame *slot = &slots[next_start % sizeof_array(slots)];
+
+	/* rmt_transmit() blocks until a queued frame is done */
+	if (next_start - next_done >= TRANSFER_QUEUE_DEPTH)
+		stats.stalls++;
+
+	load_frame(slot, frame);
+	frame_start[next_start % sizeof_array(frame_start)] =
+		esp_timer_get_time();
+
+	err = rmt_transmit(tx_channel, encoder, slot, sizeof(*slot), &conf);
+	if (err)
+		return 1;
+
+	next_start++;
+	stats.frames++;
+
+	return 0;
+}
+
+int transmit_signal(const frame_info_t *frame)
+{
+	int err;
+
+	/*
+	 * the carrier is per channel, wait for queued frames of the previous
+	 * protocol to go out first
+	 */
+	if (frame->proto != carrier) {
+		if (is_bursting)
+			wait_queue_empty();
+		err = apply_carrier(frame->proto);
+		if (err)
+			return 1;
+	}
+
+	err = start_burst();
+	if (err)
+		return 1;
+
+	return queue_frame(frame);
+}
+
+int wait_transmit_done(void)
+{
+	int err;
+
+	if (!is_bursting)
+		return 0;
+
+	err = wait_queue_empty();
+	if (err)
+		return 1;
+
+	return end_burst();
+}
+
+void get_transmit_stats(struct transmit_stats *st)
+{
+	*st = stats;
+}
+
+void reset_transmit_stats(void)
+{
+	memset(&stats, 0, sizeof(stats));
+	next_start = next_done = 0;
+}
@@ -0,0 +1,55 @@
+/****************************************************************************
+**
+** Copyright 2024 Jiamu Sun
+** Contact: barroit@linux.com
+**
+** This file is part of livaut.
+**
+** livaut is free software: you can redistribute it and/or modify it
+** under the terms of the GNU General Public License as published by the
+** Free Software Foundation, either version 3 of the License, or (at your
+** option) any later version.
+**
+** livaut is distributed in the hope that it will be useful, but
+** WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+** General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License along
+** with livaut. If not, see <https://www.gnu.org/licenses/>.
+**
+****************************************************************************/
+
+#ifndef TRANSMIT_H
+#define TRANSMIT_H
+
+#include "types.h"
+#include "signal-schedule-def.h"
+
+#define TRANSFER_QUEUE_DEPTH 4
+
+/* frames loaded out of flash, one for each queued and each in flight */
+#define TRANSFER_SLOTS (TRANSFER_QUEUE_DEPTH * 2)
+
+struct transmit_stats {
+	u32 frames;      /* frames queued */
+	u32 done;        /* frames gone out */
+	u32 stalls;      /* times the tx queue was full */
+	u64 latency_sum; /* µs, from rmt_transmit() to completion */
+	u64 latency_max;
+};
+
+int setup_transmitter(void);
+
+int teardown_transmitter(void);
+
+int transmit_signal(const frame_info_t *frame);
+
+/* also ends the burst, the cpu may slow down again after it */
+int wait_transmit_done(void);
+
+void get_transmit_stats(struct transmit_stats *stats);
+
+void reset_transmit_stats(void);
+
+#endif /* TRANSMIT_H */
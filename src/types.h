@@ -32,6 +32,9 @@ typedef uint16_t u16;
 typedef uint32_t u32;
 typedef uint64_t u64;
 
+typedef int32_t s32;
+typedef int64_t s64;
+
 #define FIELD_TYPEOF(t, f) typeof(((t *)0)->f)
 
 #endif /* TYPES_H */
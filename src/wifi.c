@@ -1,8 +1,14 @@
 #include "wifi.h"
 #include "esp_wifi.h"
+#include "esp_netif.h"
+#include "esp_attr.h"
+#include "esp_rom_crc.h"
 #include "freertos/event_groups.h"
+#include "esp_timer.h"
 #include <string.h>
+#include <stddef.h>
 #include "termio.h"
+#include "types.h"
 
 #define RETRY_GIVEUP 5
 
@@ -12,6 +18,29 @@
 #define STA2AP_START_SUCCESS BIT0
 #define STA2AP_STATES        (STA2AP_START_FAILURE | STA2AP_START_SUCCESS)
 
+#define ASSOC_CACHE_VERSION 1
+
+/* dhcp is asked again after this many joins, the lease may have moved */
+#define ASSOC_CACHE_USES 32
+
+/*
+ * the ap and addresses of the last good connection, a reconnect joins that
+ * bssid on its channel and skips dhcp, anything failing falls back to the
+ * full scan
+ */
+struct assoc_cache {
+	u32 version;
+	u8 bssid[6];
+	u8 channel;
+	u8 uses;
+	esp_netif_ip_info_t ip;
+	esp_ip4_addr_t dns;
+	u32 crc; /* of the fields above */
+};
+
+static RTC_DATA_ATTR struct assoc_cache cache;
+static int is_cache_used;
+
 static EventGroupHandle_t sta2ap_state;
 static esp_netif_t *netif;
 static esp_event_handler_instance_t wifi_event_handle;
@@ -23,20 +52,95 @@ static int is_disconnect_call;
 static int is_communicating;
 static char router_address[16];
 
+static int is_radio_on;
+static u64 radio_start; /* µs */
+static u64 radio_time;  /* µs, this boot */
+
 #define TAG "wifi_init"
 
+static u32 get_cache_crc(void)
+{
+	return esp_rom_crc32_le(0, (const u8 *)&cache,
+				offsetof(struct assoc_cache, crc));
+}
+
+static int is_cache_valid(void)
+{
+	return cache.version == ASSOC_CACHE_VERSION &&
+	       cache.crc == get_cache_crc();
+}
+
+static void save_cache(const esp_netif_ip_info_t *ip)
+{
+	wifi_ap_record_t ap;
+	esp_netif_dns_info_t dns;
+	int err;
+
+	err = esp_wifi_sta_get_ap_info(&ap) ||
+	      esp_netif_get_dns_info(netif, ESP_NETIF_DNS_MAIN, &dns);
+	if (err)
+		return;
+
+	memcpy(cache.bssid, ap.bssid, sizeof(cache.bssid));
+	cache.channel = ap.primary;
+	cache.ip      = *ip;
+	cache.dns     = dns.ip.u_addr.ip4;
+	cache.uses    = 0;
+	cache.version = ASSOC_CACHE_VERSION;
+	cache.crc     = get_cache_crc();
+}
+
+void forget_sta2ap_cache(void)
+{
+	cache.version = 0;
+}
+
+static void set_static_address(void)
+{
+	esp_netif_dns_info_t dns = {
+		.ip.type = ESP_IPADDR_TYPE_V4,
+		.ip.u_addr.ip4 = cache.dns,
+	};
+
+	esp_netif_dhcpc_stop(netif);
+	CE(esp_netif_set_ip_info(netif, &cache.ip));
+	CE(esp_netif_set_dns_info(netif, ESP_NETIF_DNS_MAIN, &dns));
+}
+
+static int setup_sta_config(void);
+
+static void drop_cache(void)
+{
+	info(TAG, "cached ap did not answer, scanning");
+
+	forget_sta2ap_cache();
+	setup_sta_config();
+	esp_netif_dhcpc_start(netif);
+}
+
 static void handle_wifi_event(void *, esp_event_base_t, int32_t id, void *)
 {
 	switch (id) {
 	case WIFI_EVENT_STA_START:
 		esp_wifi_connect();
 		break;
+	case WIFI_EVENT_STA_CONNECTED:
+		/* ip_event comes once the address is set */
+		if (is_cache_used)
+			set_static_address();
+		break;
 	case WIFI_EVENT_STA_DISCONNECTED:
 		if (is_disconnect_call) {
 			is_disconnect_call = 0;
 			break;
 		}
 
+		if (is_cache_used) {
+			drop_cache();
+			esp_wifi_connect();
+			break;
+		}
+
 		if (retry_count++ < RETRY_GIVEUP) {
 			if (retry_count % 2) {
 				info(TAG, "trying to connect to ‘%s’",
@@ -58,6 +162,10 @@ static void handle_ip_event(void *, esp_event_base_t, int32_t id, void *ctx)
 
 		ip_event_got_ip_t *data = ctx;
 		snprintf(router_address, 16, IPSTR, IP2STR(&data->ip_info.gw));
+
+		/* addresses from dhcp, static ones came from the cache */
+		if (!is_cache_used)
+			save_cache(&data->ip_info);
 	}
 }
 
@@ -119,6 +227,17 @@ static int setup_sta_config(void)
 		.sort_method     = WIFI_CONNECT_AP_BY_SECURITY,
 	};
 
+	/* a directed join, no scan of the other channels */
+	is_cache_used = is_cache_valid() && cache.uses < ASSOC_CACHE_USES;
+	if (is_cache_used) {
+		cache.uses++;
+		cache.crc = get_cache_crc();
+
+		memcpy(sta_conf.bssid, cache.bssid, sizeof(sta_conf.bssid));
+		sta_conf.bssid_set = true;
+		sta_conf.channel   = cache.channel;
+	}
+
 	wifi_config_t wifi_conf = {
 		.sta = sta_conf,
 	};
@@ -178,25 +297,47 @@ int is_sta2ap_connected(void)
 	return is_communicating;
 }
 
+static void stop_radio(void)
+{
+	u64 on;
+
+	esp_wifi_stop();
+	is_communicating = 0;
+
+	if (!is_radio_on)
+		return;
+
+	on = esp_timer_get_time() - radio_start;
+	radio_time += on;
+	is_radio_on = 0;
+
+	info(TAG, "radio was on for %" PRIu64 "ms", on / 1000);
+}
+
 void disconnect_sta2ap(void)
 {
 	is_disconnect_call = 1;
 	esp_wifi_disconnect();
 
-	esp_wifi_stop();
-	is_communicating = 0;
+	stop_radio();
 }
 
 int connect_sta2ap(void)
 {
 	int err;
 
+	retry_count = 0;
+	radio_start = esp_timer_get_time();
+	is_radio_on = 1;
+
 	err = CE(esp_wifi_start());
 	if (err)
 		goto err_wifi_start;
 
+	/* a wake-up that syncs is counted on this, see SCHEDULER_SYNC_LEAD */
 	EventBits_t bit = xEventGroupWaitBits(sta2ap_state, STA2AP_STATES,
-					      pdFALSE, pdFALSE, portMAX_DELAY);
+			pdFALSE, pdFALSE,
+			pdMS_TO_TICKS(CONFIG_WIFI_JOIN_TIMEOUT * 1000));
 	xEventGroupClearBits(sta2ap_state, STA2AP_STATES);
 
 	if (bit != STA2AP_START_SUCCESS) {
@@ -209,10 +350,24 @@ int connect_sta2ap(void)
 
 err_wifi_start:
 	disconnect_sta2ap();
+	return 1;
+
 err_wifi_connect:
+	/* not associated, nothing to disconnect from */
+	stop_radio();
 	return 1;
 }
 
+u64 get_radio_time(void)
+{
+	u64 time = radio_time;
+
+	if (is_radio_on)
+		time += esp_timer_get_time() - radio_start;
+
+	return time / 1000;
+}
+
 typedef void (*setup_wifi_task_cb)(int err);
 
 void make_sta2ap_connection(void *cb)
@@ -23,6 +23,8 @@
 #ifndef WIFI_H
 #define WIFI_H
 
+#include "types.h"
+
 void make_sta2ap_connection(void *);
 
 int is_sta2ap_connected(void);
@@ -31,4 +33,10 @@ void disconnect_sta2ap(void);
 
 int connect_sta2ap(void);
 
+/* ms the radio was on in this boot */
+u64 get_radio_time(void);
+
+/* the next connection scans and asks dhcp again */
+void forget_sta2ap_cache(void);
+
 #endif /* WIFI_H */